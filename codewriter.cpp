@@ -0,0 +1,210 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "codewriter.h"
+#include <QtCore/QIODevice>
+
+// Big enough for most classes, so their code needs a single allocation.
+static const int chunkSize = 64 * 1024;
+
+const char* indentationSpaces(int level)
+{
+    static const char spaces[] = "                                                                ";
+    static const int maxLevel = (sizeof(spaces) - 1) / 4;
+    return spaces + (maxLevel - qBound(0, level, maxLevel)) * 4;
+}
+
+CodeWriter::CodeWriter(int sizeHint) : m_size(0), m_sizeHint(sizeHint > 0 ? sizeHint : chunkSize)
+{
+}
+
+char* CodeWriter::grow(int size)
+{
+    if (m_chunks.isEmpty() || m_chunks.last().capacity() - m_chunks.last().size() < size) {
+        QByteArray chunk;
+        chunk.reserve(qMax(m_chunks.isEmpty() ? m_sizeHint : chunkSize, size));
+        m_chunks << chunk;
+    }
+    QByteArray& chunk = m_chunks.last();
+    int oldSize = chunk.size();
+    chunk.resize(oldSize + size);
+    m_size += size;
+    return chunk.data() + oldSize;
+}
+
+void CodeWriter::append(const char* data, int size)
+{
+    if (size > 0)
+        qMemCopy(grow(size), data, size);
+}
+
+CodeWriter& CodeWriter::indent()
+{
+    return *this << m_indentor;
+}
+
+CodeWriter& CodeWriter::operator<<(const Indentor& indentor)
+{
+    for (int level = indentor.indent; level > 0; level -= 16)
+        append(indentationSpaces(level), qMin(level, 16) * 4);
+    return *this;
+}
+
+CodeWriter& CodeWriter::operator<<(const char* literal)
+{
+    append(literal, qstrlen(literal));
+    return *this;
+}
+
+CodeWriter& CodeWriter::operator<<(const QByteArray& utf8)
+{
+    append(utf8.constData(), utf8.size());
+    return *this;
+}
+
+CodeWriter& CodeWriter::operator<<(const QString& text)
+{
+    // Most generated code is ASCII, which is copied without going through a codec.
+    int size = text.size();
+    if (!size)
+        return *this;
+    const QChar* chars = text.constData();
+    char* out = grow(size);
+    for (int i = 0; i < size; ++i) {
+        ushort c = chars[i].unicode();
+        if (c >= 0x80) {
+            m_chunks.last().chop(size);
+            m_size -= size;
+            return *this << text.toUtf8();
+        }
+        out[i] = char(c);
+    }
+    return *this;
+}
+
+CodeWriter& CodeWriter::operator<<(QChar c)
+{
+    if (c.unicode() < 0x80)
+        return *this << char(c.unicode());
+    return *this << QString(c);
+}
+
+CodeWriter& CodeWriter::operator<<(char c)
+{
+    *grow(1) = c;
+    return *this;
+}
+
+CodeWriter& CodeWriter::operator<<(int number)
+{
+    return *this << QByteArray::number(number);
+}
+
+CodeWriter& CodeWriter::operator<<(uint number)
+{
+    return *this << QByteArray::number(number);
+}
+
+CodeWriter& CodeWriter::operator<<(long number)
+{
+    return *this << QByteArray::number(qlonglong(number));
+}
+
+CodeWriter& CodeWriter::operator<<(ulong number)
+{
+    return *this << QByteArray::number(qulonglong(number));
+}
+
+CodeWriter& CodeWriter::operator<<(qlonglong number)
+{
+    return *this << QByteArray::number(number);
+}
+
+CodeWriter& CodeWriter::operator<<(qulonglong number)
+{
+    return *this << QByteArray::number(number);
+}
+
+QByteArray CodeWriter::toByteArray() const
+{
+    if (m_chunks.size() == 1)
+        return m_chunks.first();
+    QByteArray result;
+    result.reserve(m_size);
+    foreach (const QByteArray& chunk, m_chunks)
+        result += chunk;
+    return result;
+}
+
+void CodeWriter::clear()
+{
+    m_chunks.clear();
+    m_size = 0;
+}
+
+class CodeWriterStream::Device : public QIODevice
+{
+public:
+    Device(CodeWriter& writer) : m_writer(writer)
+    {
+        open(QIODevice::WriteOnly);
+    }
+
+protected:
+    qint64 readData(char*, qint64)
+    {
+        return -1;
+    }
+
+    qint64 writeData(const char* data, qint64 size)
+    {
+        // Reads the encoded text as Latin-1 and writes it as UTF-8.
+        const char* end = data + size;
+        const char* run = data;
+        for (const char* c = data; c != end; ++c) {
+            uchar byte = uchar(*c);
+            if (byte < 0x80)
+                continue;
+            m_writer.append(run, c - run);
+            m_writer << char(0xc0 | (byte >> 6)) << char(0x80 | (byte & 0x3f));
+            run = c + 1;
+        }
+        m_writer.append(run, end - run);
+        return size;
+    }
+
+private:
+    CodeWriter& m_writer;
+};
+
+CodeWriterStream::CodeWriterStream(CodeWriter& writer) : m_device(new Device(writer))
+{
+    setDevice(m_device);
+}
+
+CodeWriterStream::~CodeWriterStream()
+{
+    flush();
+    setDevice(0);
+    delete m_device;
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CODEWRITER_H
+#define CODEWRITER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QTextStream>
+#include "generatorrunnermacros.h"
+
+/**
+* Utility class to store the identation level, use it in a QTextStream or a CodeWriter.
+*/
+class GENRUNNER_API Indentor
+{
+public:
+    Indentor() : indent(0) {}
+    int indent;
+};
+
+/**
+*   Class that use the RAII idiom to set and unset the identation level.
+*/
+class GENRUNNER_API Indentation
+{
+public:
+    Indentation(Indentor &indentor) : indentor(indentor)
+    {
+        indentor.indent++;
+    }
+    ~Indentation()
+    {
+        indentor.indent--;
+    }
+
+private:
+    Indentor &indentor;
+};
+
+/// Returns the spaces of \p level indentation levels, up to 16 levels.
+GENRUNNER_API const char* indentationSpaces(int level);
+
+GENRUNNER_API inline QTextStream &operator <<(QTextStream &s, const Indentor &indentor)
+{
+    for (int level = indentor.indent; level > 0; level -= 16)
+        s << indentationSpaces(level);
+    return s;
+}
+
+/**
+ *   Buffer for generated code, kept as UTF-8 bytes in chunks that are allocated
+ *   once with their final size, so the code is never copied while it grows nor
+ *   converted again when written to a file.
+ *
+ *   The writer has its own indentation level, see indentor() and indent().
+ *   Literals are expected to be ASCII or UTF-8; strings used many times can be
+ *   converted once with QString::toUtf8() and appended as QByteArray.
+ */
+class GENRUNNER_API CodeWriter
+{
+public:
+    /// Creates an empty writer, whose first chunk holds at least \p sizeHint bytes.
+    explicit CodeWriter(int sizeHint = 0);
+
+    /// The indentation level written by indent(), to be used with Indentation.
+    Indentor& indentor() { return m_indentor; }
+    /// Writes the indentation of the writer's own level.
+    CodeWriter& indent();
+
+    CodeWriter& operator<<(const char* literal);
+    CodeWriter& operator<<(const QByteArray& utf8);
+    CodeWriter& operator<<(const QString& text);
+    CodeWriter& operator<<(QChar c);
+    CodeWriter& operator<<(char c);
+    CodeWriter& operator<<(int number);
+    CodeWriter& operator<<(uint number);
+    CodeWriter& operator<<(long number);
+    CodeWriter& operator<<(ulong number);
+    CodeWriter& operator<<(qlonglong number);
+    CodeWriter& operator<<(qulonglong number);
+    /// Writes the indentation of \p indentor level.
+    CodeWriter& operator<<(const Indentor& indentor);
+
+    void append(const char* data, int size);
+
+    /// Number of bytes written.
+    int size() const { return m_size; }
+    bool isEmpty() const { return !m_size; }
+    /// Returns the written code, without copying it when it fits in one chunk.
+    QByteArray toByteArray() const;
+    void clear();
+
+private:
+    // Makes room for \p size more bytes, returning where to write them.
+    char* grow(int size);
+
+    QList<QByteArray> m_chunks;
+    int m_size;
+    int m_sizeHint;
+    Indentor m_indentor;
+};
+
+/**
+ *   A QTextStream that writes into a CodeWriter, for generators written against
+ *   QTextStream. The text is encoded as the files written from QTextStream always
+ *   were: with the locale codec, then read as Latin-1 and written as UTF-8, which
+ *   leaves ASCII untouched. The stream must be flushed before the writer is used
+ *   directly; it is flushed when destroyed.
+ */
+class GENRUNNER_API CodeWriterStream : public QTextStream
+{
+public:
+    explicit CodeWriterStream(CodeWriter& writer);
+    ~CodeWriterStream();
+
+private:
+    class Device;
+    Device* m_device;
+};
+
+#endif // CODEWRITER_H
@@ -23,119 +23,558 @@
 
 #include "generator.h"
 #include "reporthandler.h"
-#include "fileout.h"
 #include "apiextractor.h"
-
+#include "generatorrunnerconfig.h"
+#include "outputarchive.h"
+#include "outputcache.h"
+#include "outputmanifest.h"
+#include "outputqueue.h"
+#include "profiler.h"
+#include "symboltable.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
 #include <QtCore/QDir>
+#include <QtCore/QDirIterator>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
 #include <QDebug>
 #include <typedatabase.h>
+#include <climits>
+
+/// The prefix of the C++ signature of a constant type, stripped by ExcludeConst.
+static const QLatin1String constPrefix("const ");
+static const int constPrefixLength = int(qstrlen(constPrefix.latin1()));
+
+struct TranslatedTypeKey
+{
+    const AbstractMetaType* type;
+    const AbstractMetaClass* context;
+    int options;
+
+    bool operator==(const TranslatedTypeKey& other) const
+    {
+        return type == other.type && context == other.context && options == other.options;
+    }
+};
+
+static inline uint qHash(const TranslatedTypeKey& key)
+{
+    return qHash(key.type) ^ qHash(key.context) ^ uint(key.options);
+}
+
+struct ContainerUseKey
+{
+    QString containerName;
+    Generator::ContainerUse use;
+
+    bool operator==(const ContainerUseKey& other) const
+    {
+        return containerName == other.containerName && use.metaClass == other.use.metaClass
+               && use.function == other.use.function && use.field == other.use.field;
+    }
+};
+
+static inline uint qHash(const ContainerUseKey& key)
+{
+    return qHash(key.containerName) ^ qHash(key.use.metaClass) ^ qHash(key.use.function) ^ qHash(key.use.field);
+}
+
+struct TranslatedType
+{
+    // The signatures of the type when it was translated. Generators may translate
+    // temporary types, so a new type at the same address must not get the old result.
+    QString cppSignature;
+    QString originalTypeDescription;
+    QString translation;
+};
+
+// A piece of a code snippet: literal text, or a variable expanded by replaceTemplateVariables().
+struct TemplateSegment
+{
+    enum Kind {
+        Literal,
+        Type,
+        Argument,
+        ReturnType,
+        FunctionName,
+        ArgumentNames,
+        Arguments
+    };
+
+    Kind kind;
+    // The literal text, or the variable as written, kept when it can't be expanded.
+    QString text;
+    int argument;
+};
+
+struct CodeTemplate
+{
+    QList<TemplateSegment> segments;
+    int literalSize;
+};
 
 struct Generator::GeneratorPrivate {
+    GeneratorPrivate() : minimalConstructorMutex(QMutex::Recursive) {}
+
+    // Starts building a minimal constructor, returning the state to give to
+    // endMinimalConstructor().
+    int beginMinimalConstructor()
+    {
+        int savedCycleCut = minimalConstructorCycleCut;
+        minimalConstructorCycleCut = INT_MAX;
+        return savedCycleCut;
+    }
+
+    // Returns true if the constructor just built can be cached, that is, if it
+    // doesn't depend on a class still in progress that was skipped to break a cycle.
+    bool endMinimalConstructor(int savedCycleCut)
+    {
+        bool complete = minimalConstructorCycleCut >= classesInProgress.size();
+        minimalConstructorCycleCut = complete ? savedCycleCut : qMin(savedCycleCut, minimalConstructorCycleCut);
+        return complete;
+    }
+
     const ApiExtractor* apiextractor;
     QString outDir;
     // License comment
     QString licenseComment;
     QString packageName;
+    QStringList packageNames;
     int numGenerated;
-    int numGeneratedWritten;
-    QStringList instantiatedContainersNames;
+    QAtomicInt numGeneratedWritten;
+    int numberOfJobs;
+    int outputThreads;
+    qint64 outputQueueLimit;
+    OutputQueue* outputQueue;
+    bool useOutputManifest;
+    int shard;
+    int shardCount;
+    int mergeShardCount;
+    int unityFiles;
+    OutputCache* outputCache;
+    OutputArchiveWriter* outputArchive;
+    bool outputCacheRun;
+    int outputCacheHits;
+    int outputCacheMisses;
+    QList<QByteArray> pendingCacheKeys;
+    OutputManifest outputManifest;
+    bool incremental;
+    QString pluginFileName;
+    QByteArray inputContentsDigest;
+    QByteArray generatorFingerprint;
+    QMap<QString, QString> args;
+    bool incrementalRun;
+    QHash<QString, QByteArray> newManifest;
+    QMutex classDigestsMutex;
+    QHash<const AbstractMetaClass*, QByteArray> classDigests;
+    QList<const AbstractMetaClass*> pendingClasses;
+    QStringList pendingFileNames;
+    QStringList pendingFilePaths;
+    QSet<QString> instantiatedContainersNames;
     QList<const AbstractMetaType*> instantiatedContainers;
+    QHash<QString, QList<ContainerUse> > containerUses;
+    QSet<ContainerUseKey> containerUseKeys;
+    QHash<const AbstractMetaClass*, QStringList> containersByClass;
+    QHash<const TypeEntry*, AbstractMetaClass*> classesByTypeEntry;
+    QHash<QString, AbstractMetaClass*> classesByCppName;
+    QHash<QString, AbstractMetaClass*> classesByTargetLangName;
+    QHash<QString, AbstractMetaClass*> classesByName;
+    QMutex minimalConstructorMutex;
+    QHash<const TypeEntry*, QString> typeEntryConstructors;
+    QHash<QPair<const TypeEntry*, QString>, QString> metaTypeConstructors;
+    QHash<const AbstractMetaClass*, QString> classConstructors;
+    // Classes whose minimal constructor is being built, and the position among
+    // them of the outermost one found again while building another one.
+    QList<const AbstractMetaClass*> classesInProgress;
+    int minimalConstructorCycleCut;
+    int minimalConstructorCacheHits;
+    int minimalConstructorCacheMisses;
+    QReadWriteLock translatedTypesLock;
+    QHash<TranslatedTypeKey, TranslatedType> translatedTypes;
+    AbstractMetaClassList classes;
+    AbstractMetaFunctionList globalFunctions;
+    AbstractMetaEnumList globalEnums;
+    QList<const PrimitiveTypeEntry*> primitiveTypes;
+    QList<const ContainerTypeEntry*> containerTypes;
+    QMutex filesMutex;
+    QSet<QString> inputFiles;
+    QStringList changedFiles;
+    QReadWriteLock codeTemplatesLock;
+    QHash<QString, CodeTemplate> codeTemplates;
 };
 
+// The SymbolTable names the model of the generators alive, so it is cleared when the last
+// one is destroyed, or when a generator is set up with another model. The --output-cache
+// they share is deleted with the last one too.
+static QMutex symbolTableMutex;
+static int liveGenerators = 0;
+static const ApiExtractor* symbolTableExtractor = 0;
+static OutputCache* outputCache = 0;
+
 Generator::Generator() : m_d(new GeneratorPrivate)
 {
+    {
+        QMutexLocker locker(&symbolTableMutex);
+        ++liveGenerators;
+    }
     m_d->numGenerated = 0;
     m_d->numGeneratedWritten = 0;
+    m_d->numberOfJobs = 1;
+    m_d->outputThreads = 0;
+    m_d->outputQueueLimit = 64 * 1024 * 1024;
+    m_d->outputQueue = 0;
+    m_d->useOutputManifest = true;
+    m_d->shard = 0;
+    m_d->shardCount = 0;
+    m_d->mergeShardCount = 0;
+    m_d->unityFiles = 0;
+    m_d->outputCache = 0;
+    m_d->outputArchive = 0;
+    m_d->outputCacheRun = false;
+    m_d->outputCacheHits = 0;
+    m_d->outputCacheMisses = 0;
+    m_d->incremental = false;
+    m_d->incrementalRun = false;
     m_d->instantiatedContainers = QList<const AbstractMetaType*>();
-    m_d->instantiatedContainersNames = QStringList();
+    m_d->minimalConstructorCycleCut = INT_MAX;
+    m_d->minimalConstructorCacheHits = 0;
+    m_d->minimalConstructorCacheMisses = 0;
 }
 
 Generator::~Generator()
 {
+    delete m_d->outputQueue;
     delete m_d;
+
+    QMutexLocker locker(&symbolTableMutex);
+    if (!--liveGenerators) {
+        SymbolTable::instance()->clear();
+        symbolTableExtractor = 0;
+        delete outputCache;
+        outputCache = 0;
+    }
+}
+
+/**
+ *  Returns the --output-cache shared by all the generators of the run, or 0 if
+ *  its size limit is not valid.
+ */
+static OutputCache* sharedOutputCache(const QMap<QString, QString>& args)
+{
+    QMutexLocker locker(&symbolTableMutex);
+    if (!outputCache) {
+        qint64 maxSize = 1024;
+        if (args.contains("output-cache-size")) {
+            maxSize = args.value("output-cache-size").toLongLong();
+            if (maxSize < 1) {
+                ReportHandler::warning(QString("invalid output cache size '%1'").arg(args.value("output-cache-size")));
+                return 0;
+            }
+        }
+        outputCache = new OutputCache(args.value("output-cache"), maxSize * 1024 * 1024);
+    }
+    return outputCache;
+}
+
+/**
+ *  Returns the --output-archive shared by all the generators of the run, or 0 if it
+ *  can't be created.
+ */
+static OutputArchiveWriter* sharedOutputArchive(const QString& fileName)
+{
+    static OutputArchiveWriter* archive = 0;
+    if (!archive) {
+        OutputArchiveWriter* newArchive = new OutputArchiveWriter(fileName);
+        if (!newArchive->open()) {
+            ReportHandler::warning(QString("unable to create the output archive '%1': %2")
+                                   .arg(fileName).arg(newArchive->errorString()));
+            delete newArchive;
+            return 0;
+        }
+        archive = newArchive;
+    }
+    return archive;
+}
+
+/// Returns the digest of the contents of a file, so copies of the same file get the same one.
+static QByteArray fileDigest(const QString& fileName)
+{
+    static QHash<QString, QByteArray> digests;
+    if (!digests.contains(fileName)) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly)) {
+            while (!file.atEnd())
+                hash.addData(file.read(64 * 1024));
+        }
+        digests.insert(fileName, hash.result().toHex());
+    }
+    return digests.value(fileName);
+}
+
+/**
+ *  Returns the names of the typesystems whose code is generated, in the type database
+ *  order. The typesystems are all loaded by the time the generators are set up, so the
+ *  type database is scanned only once and all the generators share the result.
+ */
+static QStringList generatingPackages()
+{
+    static QMutex mutex;
+    static bool scanned = false;
+    static QStringList packages;
+    QMutexLocker locker(&mutex);
+    if (!scanned) {
+        const TypeEntryHash& allEntries = TypeDatabase::instance()->allEntries();
+        for (TypeEntryHash::const_iterator it = allEntries.constBegin(); it != allEntries.constEnd(); ++it) {
+            foreach (const TypeEntry* entry, it.value()) {
+                if (entry->type() == TypeEntry::TypeSystemType && entry->generateCode() && !packages.contains(entry->name()))
+                    packages << entry->name();
+            }
+        }
+        scanned = true;
+    }
+    return packages;
 }
 
 bool Generator::setup(const ApiExtractor& extractor, const QMap< QString, QString > args)
 {
     m_d->apiextractor = &extractor;
-    TypeEntryHash allEntries = TypeDatabase::instance()->allEntries();
-    TypeEntry* entryFound = 0;
-    foreach (QList<TypeEntry*> entryList, allEntries.values()) {
-        foreach (TypeEntry* entry, entryList) {
-            if (entry->type() == TypeEntry::TypeSystemType && entry->generateCode()) {
-                entryFound = entry;
-                break;
-            }
+    m_d->args = args;
+    m_d->incremental = args.contains("incremental");
+    m_d->useOutputManifest = !args.contains("no-output-manifest");
+    if (args.contains("shard")) {
+        QStringList shard = args.value("shard").split('/');
+        m_d->shard = shard.first().toInt();
+        m_d->shardCount = shard.last().toInt();
+        if (shard.size() != 2 || m_d->shard < 1 || m_d->shard > m_d->shardCount) {
+            ReportHandler::warning(QString("invalid shard '%1', expected <shard>/<number of shards>").arg(args.value("shard")));
+            return false;
         }
-        if (entryFound)
-            break;
     }
-    if (entryFound)
-        m_d->packageName = entryFound->name();
+    if (args.contains("merge-shards")) {
+        m_d->mergeShardCount = args.value("merge-shards").toInt();
+        if (m_d->mergeShardCount < 1) {
+            ReportHandler::warning(QString("invalid number of shards '%1'").arg(args.value("merge-shards")));
+            return false;
+        }
+    }
+    if (args.contains("unity-files")) {
+        m_d->unityFiles = args.value("unity-files").toInt();
+        if (m_d->unityFiles < 1) {
+            ReportHandler::warning(QString("invalid number of unity files '%1'").arg(args.value("unity-files")));
+            return false;
+        }
+    }
+    if (!args.value("output-cache").isEmpty()) {
+        m_d->outputCache = sharedOutputCache(args);
+        if (!m_d->outputCache)
+            return false;
+    }
+    if (!args.value("output-archive").isEmpty()) {
+        m_d->outputArchive = sharedOutputArchive(args.value("output-archive"));
+        if (!m_d->outputArchive)
+            return false;
+        // The archive is written from scratch, so no file can be skipped as up to date.
+        m_d->incremental = false;
+        m_d->useOutputManifest = false;
+    }
+    m_d->outputThreads = args.value("output-threads").toInt();
+    if (args.value("output-queue-limit").toInt() > 0)
+        m_d->outputQueueLimit = args.value("output-queue-limit").toInt() * qint64(1024 * 1024);
+    Profiler::Timer setupTimer;
+    m_d->classes = extractor.classes();
+    m_d->globalFunctions = extractor.globalFunctions();
+    m_d->globalEnums = extractor.globalEnums();
+    m_d->primitiveTypes = extractor.primitiveTypes();
+    m_d->containerTypes = extractor.containerTypes();
+    buildClassIndexes();
+    {
+        QMutexLocker locker(&symbolTableMutex);
+        if (symbolTableExtractor != &extractor) {
+            SymbolTable::instance()->clear();
+            symbolTableExtractor = &extractor;
+        }
+    }
+    m_d->classDigests.clear();
+    m_d->typeEntryConstructors.clear();
+    m_d->metaTypeConstructors.clear();
+    m_d->classConstructors.clear();
+    m_d->translatedTypes.clear();
+    m_d->instantiatedContainersNames.clear();
+    m_d->instantiatedContainers.clear();
+    m_d->containerUses.clear();
+    m_d->containerUseKeys.clear();
+    m_d->containersByClass.clear();
+    m_d->packageNames = generatingPackages();
+    if (!m_d->packageNames.isEmpty())
+        m_d->packageName = m_d->packageNames.first();
     else
         ReportHandler::warning("Couldn't find the package name!!");
 
+    Profiler::Timer containersTimer;
     collectInstantiatedContainers();
+    containersTimer.record("collectInstantiatedContainers", name());
 
-    return doSetup(args);
+    bool result = doSetup(args);
+    setupTimer.record("setup", name());
+    return result;
 }
 
 QString Generator::getSimplifiedContainerTypeName(const AbstractMetaType* type)
 {
-    if (!type->isContainer())
-        return type->cppSignature();
     QString typeName = type->cppSignature();
-    if (type->isConstant())
-        typeName.remove(0, sizeof("const ") / sizeof(char) - 1);
-    if (type->isReference())
-        typeName.chop(1);
-    while (typeName.endsWith('*') || typeName.endsWith(' '))
-        typeName.chop(1);
-    return typeName;
+    if (!type->isContainer())
+        return typeName;
+    SymbolTable* symbols = SymbolTable::instance();
+    int symbol = symbols->findName(SymbolTable::SimplifiedContainerTypeName, type->typeEntry(), typeName);
+    if (symbol < 0) {
+        int start = type->isConstant() ? constPrefixLength : 0;
+        int end = typeName.size();
+        if (type->isReference())
+            --end;
+        while (end > start && (typeName[end - 1] == '*' || typeName[end - 1] == ' '))
+            --end;
+        symbol = symbols->addName(SymbolTable::SimplifiedContainerTypeName, type->typeEntry(), typeName,
+                                  typeName.mid(start, end - start));
+    }
+    return symbols->name(symbol);
 }
 
-void Generator::addInstantiatedContainers(const AbstractMetaType* type)
+namespace
+{
+
+struct ContainerOccurrence
+{
+    const AbstractMetaType* type;
+    Generator::ContainerUse use;
+};
+
+}
+
+// The containers in a type are found with the innermost instantiations first.
+static void gatherContainers(const AbstractMetaType* type, const Generator::ContainerUse& use,
+                             QList<ContainerOccurrence>& occurrences)
 {
     if (!type)
         return;
     foreach (const AbstractMetaType* t, type->instantiations())
-        addInstantiatedContainers(t);
-    if (!type->typeEntry()->isContainer())
-        return;
-    QString typeName = getSimplifiedContainerTypeName(type);
-    if (!m_d->instantiatedContainersNames.contains(typeName)) {
-        m_d->instantiatedContainersNames.append(typeName);
-        m_d->instantiatedContainers.append(type);
+        gatherContainers(t, use, occurrences);
+    if (type->typeEntry()->isContainer()) {
+        ContainerOccurrence occurrence = { type, use };
+        occurrences << occurrence;
     }
 }
 
-void Generator::collectInstantiatedContainers(const AbstractMetaFunction* func)
+static void gatherContainers(const AbstractMetaFunction* func, const AbstractMetaClass* metaClass,
+                             QList<ContainerOccurrence>& occurrences)
 {
-    addInstantiatedContainers(func->type());
+    Generator::ContainerUse use = { metaClass, func, 0 };
+    gatherContainers(func->type(), use, occurrences);
     foreach (const AbstractMetaArgument* arg, func->arguments())
-        addInstantiatedContainers(arg->type());
+        gatherContainers(arg->type(), use, occurrences);
 }
 
-void Generator::collectInstantiatedContainers(const AbstractMetaClass* metaClass)
+static void gatherContainers(const AbstractMetaClass* metaClass, QList<ContainerOccurrence>& occurrences)
 {
     if (!metaClass->typeEntry()->generateCode())
         return;
     foreach (const AbstractMetaFunction* func, metaClass->functions())
-        collectInstantiatedContainers(func);
-    foreach (const AbstractMetaField* field, metaClass->fields())
-        addInstantiatedContainers(field->type());
+        gatherContainers(func, metaClass, occurrences);
+    foreach (const AbstractMetaField* field, metaClass->fields()) {
+        Generator::ContainerUse use = { metaClass, 0, field };
+        gatherContainers(field->type(), use, occurrences);
+    }
     foreach (AbstractMetaClass* innerClass, metaClass->innerClasses())
-        collectInstantiatedContainers(innerClass);
+        gatherContainers(innerClass, occurrences);
+}
+
+/// Finds the containers used by a slice of the classes, only reading the model.
+class GatherContainersTask : public QRunnable
+{
+public:
+    GatherContainersTask(const AbstractMetaClassList& classes, int first, int last, QList<ContainerOccurrence>* occurrences)
+        : m_classes(classes), m_first(first), m_last(last), m_occurrences(occurrences) {}
+
+    void run()
+    {
+        for (int i = m_first; i < m_last; ++i)
+            gatherContainers(m_classes[i], *m_occurrences);
+    }
+
+private:
+    AbstractMetaClassList m_classes;
+    int m_first;
+    int m_last;
+    QList<ContainerOccurrence>* m_occurrences;
+};
+
+void Generator::addInstantiatedContainers(const AbstractMetaType* type)
+{
+    QList<ContainerOccurrence> occurrences;
+    ContainerUse noUse = { 0, 0, 0 };
+    gatherContainers(type, noUse, occurrences);
+    foreach (const ContainerOccurrence& occurrence, occurrences)
+        addInstantiatedContainer(occurrence.type, occurrence.use);
+}
+
+void Generator::addInstantiatedContainer(const AbstractMetaType* type, const ContainerUse& use)
+{
+    QString typeName = getSimplifiedContainerTypeName(type);
+    if (!m_d->instantiatedContainersNames.contains(typeName)) {
+        m_d->instantiatedContainersNames.insert(typeName);
+        m_d->instantiatedContainers.append(type);
+    }
+    // The inner classes are walked both by themselves and with their outer class, and a
+    // function may use a container more than once, so each use is recorded once.
+    ContainerUseKey key = { typeName, use };
+    if ((use.metaClass || use.function || use.field) && !m_d->containerUseKeys.contains(key)) {
+        m_d->containerUseKeys.insert(key);
+        m_d->containerUses[typeName].append(use);
+    }
+    if (use.metaClass) {
+        QStringList& classContainers = m_d->containersByClass[use.metaClass];
+        if (!classContainers.contains(typeName))
+            classContainers.append(typeName);
+    }
 }
 
 void Generator::collectInstantiatedContainers()
 {
+    QList<ContainerOccurrence> occurrences;
     foreach (const AbstractMetaFunction* func, globalFunctions())
-        collectInstantiatedContainers(func);
-    foreach (const AbstractMetaClass* metaClass, classes())
-        collectInstantiatedContainers(metaClass);
+        gatherContainers(func, 0, occurrences);
+
+    // The classes are walked in slices by worker threads, then the containers found are
+    // added in the classes order, so the result is the one of a serial walk. The names are
+    // computed here, since the types build their signatures lazily and aren't thread safe.
+    const AbstractMetaClassList& allClasses = classes();
+    // A model without classes still has the slice of the serial walk.
+    int slices = m_d->numberOfJobs > 1 ? qMax(1, qMin(m_d->numberOfJobs * 4, allClasses.size())) : 1;
+    QVector<QList<ContainerOccurrence> > sliceOccurrences(slices);
+    if (slices > 1) {
+        QThreadPool pool;
+        pool.setMaxThreadCount(m_d->numberOfJobs);
+        for (int i = 0; i < slices; ++i) {
+            pool.start(new GatherContainersTask(allClasses, i * allClasses.size() / slices,
+                                                (i + 1) * allClasses.size() / slices, &sliceOccurrences[i]));
+        }
+        pool.waitForDone();
+    } else {
+        GatherContainersTask(allClasses, 0, allClasses.size(), &sliceOccurrences[0]).run();
+    }
+    foreach (const QList<ContainerOccurrence>& slice, sliceOccurrences)
+        occurrences << slice;
+
+    foreach (const ContainerOccurrence& occurrence, occurrences)
+        addInstantiatedContainer(occurrence.type, occurrence.use);
 }
 
 QList<const AbstractMetaType*> Generator::instantiatedContainers() const
@@ -143,34 +582,93 @@ QList<const AbstractMetaType*> Generator::instantiatedContainers() const
     return m_d->instantiatedContainers;
 }
 
+QList<Generator::ContainerUse> Generator::containerUses(const QString& containerName) const
+{
+    return m_d->containerUses.value(containerName);
+}
+
+QStringList Generator::containersUsedBy(const AbstractMetaClass* metaClass) const
+{
+    return m_d->containersByClass.value(metaClass);
+}
+
 QMap< QString, QString > Generator::options() const
 {
     return QMap<QString, QString>();
 }
 
-AbstractMetaClassList Generator::classes() const
+Generator::Capabilities Generator::capabilities() const
+{
+    return NoCapabilities;
+}
+
+const AbstractMetaClassList& Generator::classes() const
+{
+    return m_d->classes;
+}
+
+template <typename Key>
+static void addToIndex(QHash<Key, AbstractMetaClass*>& index, const Key& key, AbstractMetaClass* metaClass)
+{
+    // The first class wins, as it would in a scan of the classes.
+    if (!index.contains(key))
+        index.insert(key, metaClass);
+}
+
+void Generator::buildClassIndexes()
+{
+    m_d->classesByTypeEntry.clear();
+    m_d->classesByCppName.clear();
+    m_d->classesByTargetLangName.clear();
+    m_d->classesByName.clear();
+    foreach (AbstractMetaClass* metaClass, classes()) {
+        const TypeEntry* typeEntry = metaClass->typeEntry();
+        addToIndex(m_d->classesByTypeEntry, typeEntry, metaClass);
+        addToIndex(m_d->classesByCppName, metaClass->qualifiedCppName(), metaClass);
+        if (typeEntry)
+            addToIndex(m_d->classesByTargetLangName, typeEntry->qualifiedTargetLangName(), metaClass);
+        addToIndex(m_d->classesByName, metaClass->name(), metaClass);
+    }
+}
+
+AbstractMetaClass* Generator::findClass(const TypeEntry* typeEntry) const
+{
+    return m_d->classesByTypeEntry.value(typeEntry);
+}
+
+AbstractMetaClass* Generator::findClassByCppName(const QString& qualifiedCppName) const
+{
+    return m_d->classesByCppName.value(qualifiedCppName);
+}
+
+AbstractMetaClass* Generator::findClassByTargetLangName(const QString& qualifiedTargetLangName) const
+{
+    return m_d->classesByTargetLangName.value(qualifiedTargetLangName);
+}
+
+AbstractMetaClass* Generator::findClassByName(const QString& name) const
 {
-    return m_d->apiextractor->classes();
+    return m_d->classesByName.value(name);
 }
 
-AbstractMetaFunctionList Generator::globalFunctions() const
+const AbstractMetaFunctionList& Generator::globalFunctions() const
 {
-    return m_d->apiextractor->globalFunctions();
+    return m_d->globalFunctions;
 }
 
-AbstractMetaEnumList Generator::globalEnums() const
+const AbstractMetaEnumList& Generator::globalEnums() const
 {
-    return m_d->apiextractor->globalEnums();
+    return m_d->globalEnums;
 }
 
-QList<const PrimitiveTypeEntry*> Generator::primitiveTypes() const
+const QList<const PrimitiveTypeEntry*>& Generator::primitiveTypes() const
 {
-    return m_d->apiextractor->primitiveTypes();
+    return m_d->primitiveTypes;
 }
 
-QList<const ContainerTypeEntry*> Generator::containerTypes() const
+const QList<const ContainerTypeEntry*>& Generator::containerTypes() const
 {
-    return m_d->apiextractor->containerTypes();
+    return m_d->containerTypes;
 }
 
 const AbstractMetaEnum* Generator::findAbstractMetaEnum(const EnumTypeEntry* typeEntry) const
@@ -213,6 +711,11 @@ QString Generator::packageName() const
     return m_d->packageName;
 }
 
+QStringList Generator::packageNames() const
+{
+    return m_d->packageNames;
+}
+
 QString Generator::moduleName() const
 {
     QString& pkgName = m_d->packageName;
@@ -229,6 +732,31 @@ void Generator::setOutputDirectory(const QString &outDir)
     m_d->outDir = outDir;
 }
 
+int Generator::numberOfJobs() const
+{
+    return m_d->numberOfJobs;
+}
+
+void Generator::setNumberOfJobs(int jobs)
+{
+    m_d->numberOfJobs = qMax(jobs, 1);
+}
+
+QString Generator::pluginFileName() const
+{
+    return m_d->pluginFileName;
+}
+
+void Generator::setPluginFileName(const QString& fileName)
+{
+    m_d->pluginFileName = fileName;
+}
+
+void Generator::setInputContentsDigest(const QByteArray& digest)
+{
+    m_d->inputContentsDigest = digest;
+}
+
 int Generator::numGenerated() const
 {
     return m_d->numGenerated;
@@ -239,25 +767,870 @@ int Generator::numGeneratedAndWritten() const
     return m_d->numGeneratedWritten;
 }
 
-void Generator::generate()
+void Generator::addInputFile(const QString& fileName)
+{
+    QMutexLocker locker(&m_d->filesMutex);
+    m_d->inputFiles.insert(fileName);
+}
+
+QStringList Generator::inputFiles() const
+{
+    QMutexLocker locker(&m_d->filesMutex);
+    return m_d->inputFiles.toList();
+}
+
+void Generator::addChangedFile(const QString& fileName)
+{
+    QMutexLocker locker(&m_d->filesMutex);
+    m_d->changedFiles << fileName;
+}
+
+QStringList Generator::changedFiles() const
+{
+    QMutexLocker locker(&m_d->filesMutex);
+    return m_d->changedFiles;
+}
+
+void Generator::generateClassCode(CodeWriter& writer, const AbstractMetaClass* metaClass)
+{
+    CodeWriterStream s(writer);
+    generateClass(s, metaClass);
+}
+
+class GenerateClassTask : public QRunnable
+{
+public:
+    GenerateClassTask(Generator* generator, const AbstractMetaClass* metaClass, CodeWriter* output)
+        : m_generator(generator), m_metaClass(metaClass), m_output(output) {}
+
+    void run()
+    {
+        Profiler::Timer timer;
+        m_generator->generateClassCode(*m_output, m_metaClass);
+        timer.record("generateClass", m_metaClass->qualifiedCppName(), m_output->size());
+    }
+
+private:
+    Generator* m_generator;
+    const AbstractMetaClass* m_metaClass;
+    CodeWriter* m_output;
+};
+
+void Generator::writeClassFile(const QString& fileName, const QByteArray& contents)
+{
+    OutputManifest* manifest = m_d->useOutputManifest ? &m_d->outputManifest : 0;
+    if (m_d->outputArchive) {
+        if (writeOutputFile(fileName, contents))
+            m_d->numGeneratedWritten.ref();
+    } else if (m_d->outputQueue) {
+        m_d->outputQueue->enqueue(fileName, contents, &m_d->numGeneratedWritten, manifest);
+    } else {
+        QString errorMessage;
+        if (OutputQueue::writeFile(fileName, contents, &errorMessage, manifest)) {
+            m_d->numGeneratedWritten.ref();
+            addChangedFile(fileName);
+        } else if (!errorMessage.isEmpty())
+            ReportHandler::warning(errorMessage);
+    }
+    ++m_d->numGenerated;
+}
+
+bool Generator::writeOutputFile(const QString& fileName, const QByteArray& contents)
+{
+    if (m_d->outputArchive) {
+        QString name = QDir(QFileInfo(outputDirectory()).absoluteFilePath())
+                           .relativeFilePath(QFileInfo(fileName).absoluteFilePath());
+        if (!QDir::isAbsolutePath(name) && !name.startsWith("../")) {
+            if (m_d->outputArchive->add(name, contents))
+                return true;
+            ReportHandler::warning(QString("unable to add '%1' to the output archive '%2': %3").arg(name)
+                                   .arg(m_d->outputArchive->fileName()).arg(m_d->outputArchive->errorString()));
+            return false;
+        }
+        ReportHandler::warning(QString("'%1' is out of the output directory, written to disk instead of the output archive '%2'")
+                               .arg(fileName).arg(m_d->outputArchive->fileName()));
+    }
+
+    QString errorMessage;
+    OutputManifest* manifest = m_d->useOutputManifest ? &m_d->outputManifest : 0;
+    if (OutputQueue::writeFile(fileName, contents, &errorMessage, manifest)) {
+        addChangedFile(fileName);
+        return true;
+    }
+    if (!errorMessage.isEmpty())
+        ReportHandler::warning(errorMessage);
+    return false;
+}
+
+/**
+ *  Returns the modification times of the files in \p directory and its subdirectories.
+ */
+static QHash<QString, uint> fileModificationTimes(const QString& directory)
+{
+    QHash<QString, uint> times;
+    QDirIterator it(directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        times.insert(it.filePath(), it.fileInfo().lastModified().toTime_t());
+    }
+    return times;
+}
+
+/**
+ *  Warns about the files written into the output directory since \p filesBefore were
+ *  listed, by a generator not using writeOutputFile() in a run with --output-archive.
+ */
+static void warnFilesWrittenToDisk(const QString& directory, const QHash<QString, uint>& filesBefore,
+                                   const QString& archiveFileName)
+{
+    QString archiveFilePath = QFileInfo(archiveFileName).absoluteFilePath();
+    QHash<QString, uint> files = fileModificationTimes(directory);
+    QStringList filePaths = files.keys();
+    qSort(filePaths);
+    foreach (const QString& filePath, filePaths) {
+        QHash<QString, uint>::const_iterator before = filesBefore.find(filePath);
+        if ((before != filesBefore.constEnd() && before.value() == files.value(filePath))
+            || QFileInfo(filePath).absoluteFilePath() == archiveFilePath) {
+            continue;
+        }
+        ReportHandler::warning(QString("'%1' was written to disk instead of the output archive '%2'")
+                               .arg(filePath).arg(archiveFileName));
+    }
+}
+
+void Generator::commitOutputArchive()
+{
+    if (!m_d->outputArchive)
+        return;
+    if (m_d->outputArchive->commit()) {
+        addChangedFile(m_d->outputArchive->fileName());
+    } else {
+        ReportHandler::warning(QString("unable to write the output archive '%1': %2")
+                               .arg(m_d->outputArchive->fileName()).arg(m_d->outputArchive->errorString()));
+    }
+}
+
+static void addToHash(QCryptographicHash& hash, const QString& value)
+{
+    hash.addData(value.toUtf8());
+    hash.addData("\0", 1);
+}
+
+/**
+ *  Tells if a command line argument only changes how and where the run is done. All the
+ *  other arguments, like --api-version, the include paths and the generator options,
+ *  can change the generated code.
+ */
+static bool isRunArgument(const QString& argument)
+{
+    static const char* const runArguments[] = {
+        "changed-files", "debug-level", "depfile", "generator-set", "incremental", "jobs",
+        "license-file", "merge-shards", "model-cache", "no-output-manifest", "no-suppress-warnings",
+        "output-archive", "output-cache", "output-cache-size", "output-directory", "output-queue-limit",
+        "output-threads", "profile", "project-file", "server", "server-socket", "shard", "silent",
+        "single-pass", "unity-files", 0
+    };
+    for (int i = 0; runArguments[i]; ++i) {
+        if (argument == QLatin1String(runArguments[i]))
+            return true;
+    }
+    return false;
+}
+
+/**
+ *  Tells if a command line argument is the path of input files, like the header, the
+ *  typesystem and the documentation directories. The output cache leaves them out, since
+ *  they differ among build trees, while the contents of the model inputs are part of its key.
+ */
+static bool isPathArgument(const QString& argument)
+{
+    static const char* const pathArguments[] = {
+        "arg-1", "arg-2", "include-paths", "typesystem-paths", "library-source-dir",
+        "documentation-data-dir", "documentation-code-snippets-dir", "documentation-extra-sections-dir", 0
+    };
+    for (int i = 0; pathArguments[i]; ++i) {
+        if (argument == QLatin1String(pathArguments[i]))
+            return true;
+    }
+    return false;
+}
+
+static QHash<QString, QByteArray> readManifest(const QString& fileName)
+{
+    QHash<QString, QByteArray> manifest;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return manifest;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        if (line.endsWith('\n'))
+            line.chop(1);
+        int split = line.indexOf(' ');
+        if (split > 0)
+            manifest.insert(QString::fromUtf8(line.mid(split + 1)), line.left(split));
+    }
+    return manifest;
+}
+
+static void writeManifest(const QString& fileName, const QHash<QString, QByteArray>& manifest)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        ReportHandler::warning(QString("unable to write the generation manifest '%1'").arg(fileName));
+        return;
+    }
+    QStringList paths = manifest.keys();
+    qSort(paths);
+    foreach (const QString& path, paths)
+        file.write(manifest[path] + ' ' + path.toUtf8() + '\n');
+}
+
+/// Adds what a class declares to \p hash, without the other classes and types it uses.
+static void addClassToHash(QCryptographicHash& hash, const AbstractMetaClass* metaClass)
+{
+    addToHash(hash, metaClass->qualifiedCppName());
+    addToHash(hash, metaClass->package());
+    addToHash(hash, QString::number(metaClass->attributes()));
+    addToHash(hash, metaClass->baseClassNames().join(","));
+
+    const ComplexTypeEntry* typeEntry = metaClass->typeEntry();
+    addToHash(hash, typeEntry->targetLangName());
+    addToHash(hash, typeEntry->defaultConstructor());
+    foreach (CodeSnip snip, typeEntry->codeSnips())
+        addToHash(hash, QString("%1 %2 %3").arg(snip.position).arg(snip.language).arg(snip.code()));
+    foreach (DocModification mod, typeEntry->docModifications())
+        addToHash(hash, QString("%1 %2 %3").arg(mod.mode()).arg(mod.signature()).arg(mod.code()));
+
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        addToHash(hash, func->signature());
+        addToHash(hash, func->modifiedName());
+        addToHash(hash, QString::number(func->attributes()));
+        addToHash(hash, func->type() ? func->type()->cppSignature() : QString("void"));
+        addToHash(hash, func->implementingClass() ? func->implementingClass()->qualifiedCppName() : QString());
+        addToHash(hash, func->isModifiedRemoved() ? "removed" : "");
+        foreach (const AbstractMetaArgument* arg, func->arguments()) {
+            int argIndex = arg->argumentIndex() + 1;
+            addToHash(hash, arg->name());
+            addToHash(hash, arg->defaultValueExpression());
+            addToHash(hash, func->typeReplaced(argIndex));
+            addToHash(hash, func->argumentRemoved(argIndex) ? "removed" : "");
+        }
+        foreach (CodeSnip snip, func->injectedCodeSnips())
+            addToHash(hash, QString("%1 %2 %3").arg(snip.position).arg(snip.language).arg(snip.code()));
+    }
+
+    foreach (const AbstractMetaField* field, metaClass->fields()) {
+        addToHash(hash, field->name());
+        addToHash(hash, field->type()->cppSignature());
+        addToHash(hash, QString::number(field->attributes()));
+    }
+
+    foreach (const AbstractMetaEnum* metaEnum, metaClass->enums()) {
+        addToHash(hash, metaEnum->name());
+        foreach (const AbstractMetaEnumValue* value, metaEnum->values())
+            addToHash(hash, QString("%1=%2").arg(value->name()).arg(value->value()));
+    }
+}
+
+/// Adds what the generated code can use of a type entry, besides its class or enum.
+static void addTypeEntryToHash(QCryptographicHash& hash, const TypeEntry* entry)
+{
+    addToHash(hash, QString("%1 %2 %3 %4").arg(entry->type()).arg(entry->qualifiedCppName())
+                    .arg(entry->targetLangName()).arg(entry->codeGeneration()));
+    if (entry->isComplex()) {
+        const ComplexTypeEntry* complexEntry = static_cast<const ComplexTypeEntry*>(entry);
+        addToHash(hash, complexEntry->defaultConstructor());
+        addToHash(hash, complexEntry->isPolymorphicBase() ? "polymorphic" : "");
+    }
+}
+
+static void gatherTypeEntries(const AbstractMetaType* type, QList<const TypeEntry*>& entries)
+{
+    if (!type)
+        return;
+    entries << type->typeEntry();
+    foreach (const AbstractMetaType* instantiation, type->instantiations())
+        gatherTypeEntries(instantiation, entries);
+}
+
+QByteArray Generator::classFingerprint(const AbstractMetaClass* metaClass) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_d->generatorFingerprint);
+    addClassToHash(hash, metaClass);
+
+    // The generated code also depends on the classes and types the class uses, like
+    // whether they are value or object types, their constructors and enum values, and
+    // on the base classes of both.
+    QList<const TypeEntry*> entries;
+    for (const AbstractMetaClass* base = metaClass->baseClass(); base; base = base->baseClass())
+        entries << base->typeEntry();
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        gatherTypeEntries(func->type(), entries);
+        foreach (const AbstractMetaArgument* arg, func->arguments())
+            gatherTypeEntries(arg->type(), entries);
+    }
+    foreach (const AbstractMetaField* field, metaClass->fields())
+        gatherTypeEntries(field->type(), entries);
+
+    QSet<const TypeEntry*> hashedEntries;
+    hashedEntries.insert(metaClass->typeEntry());
+    for (int i = 0; i < entries.size(); ++i) {
+        const TypeEntry* entry = entries[i];
+        if (hashedEntries.contains(entry))
+            continue;
+        hashedEntries.insert(entry);
+        addTypeEntryToHash(hash, entry);
+        if (const AbstractMetaClass* usedClass = findClass(entry)) {
+            hash.addData(classContentsDigest(usedClass));
+            if (usedClass->baseClass())
+                entries << usedClass->baseClass()->typeEntry();
+        } else if (entry->isEnum()) {
+            if (const AbstractMetaEnum* metaEnum = findAbstractMetaEnum(entry)) {
+                foreach (const AbstractMetaEnumValue* value, metaEnum->values())
+                    addToHash(hash, QString("%1=%2").arg(value->name()).arg(value->value()));
+            }
+        }
+    }
+
+    return hash.result().toHex();
+}
+
+/// Returns the digest of what a class declares, computed once per run.
+QByteArray Generator::classContentsDigest(const AbstractMetaClass* metaClass) const
+{
+    QMutexLocker locker(&m_d->classDigestsMutex);
+    QHash<const AbstractMetaClass*, QByteArray>::const_iterator it = m_d->classDigests.constFind(metaClass);
+    if (it != m_d->classDigests.constEnd())
+        return it.value();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addClassToHash(hash, metaClass);
+    return m_d->classDigests[metaClass] = hash.result();
+}
+
+static bool heavierClass(const QPair<int, const AbstractMetaClass*>& a, const QPair<int, const AbstractMetaClass*>& b)
+{
+    return a.first > b.first;
+}
+
+/**
+ *  Splits the classes generated by a generator in \p shardCount shards balanced by
+ *  their number of functions, returning the ones of \p shard (from 1). Each class goes,
+ *  from the heaviest, to the lightest shard so far. Every shard gets the same split
+ *  for the same model.
+ */
+static QSet<const AbstractMetaClass*> classesOfShard(const Generator* generator, int shard, int shardCount)
+{
+    QList<QPair<int, const AbstractMetaClass*> > weightedClasses;
+    foreach (const AbstractMetaClass* cls, generator->classes()) {
+        if (generator->shouldGenerate(cls))
+            weightedClasses << qMakePair(cls->functions().size() + 1, cls);
+    }
+    // A stable sort keeps the model order between classes of the same weight.
+    qStableSort(weightedClasses.begin(), weightedClasses.end(), heavierClass);
+
+    QVector<qint64> shardWeights(shardCount);
+    QSet<const AbstractMetaClass*> classes;
+    for (int i = 0; i < weightedClasses.size(); ++i) {
+        int lightest = 0;
+        for (int j = 1; j < shardCount; ++j) {
+            if (shardWeights[j] < shardWeights[lightest])
+                lightest = j;
+        }
+        shardWeights[lightest] += weightedClasses[i].first;
+        if (lightest == shard - 1)
+            classes << weightedClasses[i].second;
+    }
+    return classes;
+}
+
+// AbstractMetaType and AbstractMetaFunction build their signatures the first time they are asked.
+static void buildSignatures(const AbstractMetaType* type)
+{
+    if (!type)
+        return;
+    type->cppSignature();
+    foreach (const AbstractMetaType* instantiation, type->instantiations())
+        buildSignatures(instantiation);
+}
+
+static void buildSignatures(const AbstractMetaFunction* func)
+{
+    func->signature();
+    func->minimalSignature();
+    buildSignatures(func->type());
+    foreach (const AbstractMetaArgument* arg, func->arguments())
+        buildSignatures(arg->type());
+}
+
+/**
+ *  Builds the signatures the model computes lazily, so the generation threads only read
+ *  the model: several threads asking for the signature of a type not built yet would
+ *  write it at the same time.
+ */
+static void buildModelSignatures(const Generator* generator)
+{
+    foreach (const AbstractMetaFunction* func, generator->globalFunctions())
+        buildSignatures(func);
+    foreach (const AbstractMetaClass* metaClass, generator->classes()) {
+        foreach (const AbstractMetaFunction* func, metaClass->functions())
+            buildSignatures(func);
+        foreach (const AbstractMetaField* field, metaClass->fields())
+            buildSignatures(field->type());
+    }
+}
+
+void Generator::beginGeneration()
 {
-    foreach (AbstractMetaClass *cls, m_d->apiextractor->classes()) {
+    m_d->pendingClasses.clear();
+    m_d->pendingFileNames.clear();
+    m_d->pendingFilePaths.clear();
+    m_d->pendingCacheKeys.clear();
+    m_d->newManifest.clear();
+
+    if (m_d->useOutputManifest)
+        m_d->outputManifest.load(outputManifestFileName());
+
+    if (m_d->numberOfJobs > 1 && (capabilities() & ThreadSafeGeneration)) {
+        Profiler::Timer signaturesTimer;
+        buildModelSignatures(this);
+        signaturesTimer.record("buildModelSignatures", name());
+    }
+
+    if (m_d->outputThreads > 0 && !m_d->outputQueue && !m_d->outputArchive)
+        m_d->outputQueue = new OutputQueue(m_d->outputThreads, m_d->outputQueueLimit);
+
+    m_d->incrementalRun = m_d->incremental;
+    if (m_d->incrementalRun && !(capabilities() & IncrementalGeneration)) {
+        ReportHandler::debugSparse(QString("%1 does not support incremental generation").arg(name()));
+        m_d->incrementalRun = false;
+    }
+
+    // The cached files replace generateClass(), so the same rules of the incremental generation apply.
+    m_d->outputCacheRun = m_d->outputCache && (capabilities() & IncrementalGeneration);
+    if (m_d->outputCache && !m_d->outputCacheRun)
+        ReportHandler::debugSparse(QString("%1 does not support the output cache").arg(name()));
+
+    QHash<QString, QByteArray> manifest;
+    if (m_d->incrementalRun || m_d->outputCacheRun) {
+        // Everything that is not part of the model, but changes the generated code.
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        addToHash(hash, name());
+        addToHash(hash, GENERATORRUNNER_VERSION);
+        if (m_d->outputCacheRun) {
+            // The cache is shared by build trees, each one may have its own copy of the plugin.
+            addToHash(hash, fileDigest(m_d->pluginFileName));
+        } else {
+            QFileInfo plugin(m_d->pluginFileName);
+            addToHash(hash, QString("%1 %2").arg(plugin.size()).arg(plugin.lastModified().toString(Qt::ISODate)));
+        }
+        addToHash(hash, m_d->licenseComment);
+        QMap<QString, QString>::const_iterator it = m_d->args.constBegin();
+        for (; it != m_d->args.constEnd(); ++it) {
+            if (!isRunArgument(it.key()) && !(m_d->outputCacheRun && isPathArgument(it.key())))
+                addToHash(hash, it.key() + '=' + it.value());
+        }
+        m_d->generatorFingerprint = hash.result();
+    }
+    if (m_d->incrementalRun)
+        manifest = readManifest(manifestFileName());
+
+    QSet<const AbstractMetaClass*> shardClasses;
+    if (m_d->shard && (capabilities() & ShardedGeneration))
+        shardClasses = classesOfShard(this, m_d->shard, m_d->shardCount);
+    bool generateAll = !m_d->shard || (!(capabilities() & ShardedGeneration) && m_d->shard == 1);
+
+    foreach (AbstractMetaClass *cls, classes()) {
+        if (!generateAll && !shardClasses.contains(cls))
+            continue;
         if (!shouldGenerate(cls))
             continue;
 
         QString fileName = fileNameForClass(cls);
         if (fileName.isNull())
             continue;
-        ReportHandler::debugSparse(QString("generating: %1").arg(fileName));
 
-        FileOut fileOut(outputDirectory() + '/' + subDirectoryForClass(cls) + '/' + fileName);
-        generateClass(fileOut.stream, cls);
+        QString relativePath = subDirectoryForClass(cls) + '/' + fileName;
+        QString filePath = outputDirectory() + '/' + relativePath;
+        QByteArray fingerprint;
+        if (m_d->incrementalRun || m_d->outputCacheRun)
+            fingerprint = classFingerprint(cls);
+        if (m_d->incrementalRun) {
+            m_d->newManifest.insert(relativePath, fingerprint);
+            // The output manifest tells whether the file is still the one generated, not
+            // edited or truncated since. Without it, the file is only known to be there.
+            bool upToDate = manifest.value(relativePath) == fingerprint
+                            && (m_d->useOutputManifest ? m_d->outputManifest.keep(QFileInfo(filePath))
+                                                       : QFile::exists(filePath));
+            if (upToDate) {
+                ReportHandler::debugSparse(QString("up to date: %1").arg(fileName));
+                ++m_d->numGenerated;
+                continue;
+            }
+        }
+        if (m_d->outputCacheRun) {
+            // The fingerprint misses the parts of the model not used by the class, which may
+            // still change its code, so a cached file is only used with the same inputs.
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            hash.addData(fingerprint);
+            hash.addData(m_d->inputContentsDigest);
+            addToHash(hash, packageName());
+            addToHash(hash, relativePath);
+            QByteArray key = hash.result().toHex();
+            QByteArray contents;
+            if (m_d->outputCache->fetch(key, &contents)) {
+                ReportHandler::debugSparse(QString("cached: %1").arg(fileName));
+                ++m_d->outputCacheHits;
+                writeClassFile(filePath, contents);
+                continue;
+            }
+            ++m_d->outputCacheMisses;
+            m_d->pendingCacheKeys << key;
+        }
+
+        m_d->pendingClasses << cls;
+        m_d->pendingFileNames << fileName;
+        m_d->pendingFilePaths << filePath;
+    }
+
+    // The files of the classes not generated anymore are removed. The shards don't, since
+    // a class moved to another shard is written by it at the same time.
+    if (m_d->incrementalRun && !m_d->shard) {
+        for (QHash<QString, QByteArray>::const_iterator it = manifest.constBegin(); it != manifest.constEnd(); ++it) {
+            if (!m_d->newManifest.contains(it.key()) && QFile::remove(outputDirectory() + '/' + it.key()))
+                ReportHandler::debugSparse(QString("removed: %1").arg(it.key()));
+        }
+    }
+
+    // The archive has no directories.
+    if (m_d->outputArchive)
+        return;
+
+    // The classes share a few directories, which are created once before writing any file.
+    QSet<QString> directorySet;
+    foreach (const QString& filePath, m_d->pendingFilePaths)
+        directorySet.insert(QFileInfo(filePath).absolutePath());
+    QStringList directories = directorySet.toList();
+    qSort(directories);
+    Profiler::Timer directoriesTimer;
+    OutputQueue::createDirectories(directories, m_d->numberOfJobs);
+    directoriesTimer.record("createDirectories", name(), directories.size());
+}
+
+void Generator::endGeneration()
+{
+    // The first shard bundles the classes of all the shards.
+    if (m_d->unityFiles && (capabilities() & UnityGeneration) && m_d->shard <= 1)
+        writeUnityFiles();
+
+    // finishGeneration() may rely on the class files being written.
+    if (m_d->outputQueue) {
+        m_d->outputQueue->waitForDone();
+        foreach (const QString& fileName, m_d->outputQueue->takeWrittenFiles())
+            addChangedFile(fileName);
+        delete m_d->outputQueue;
+        m_d->outputQueue = 0;
+    }
+
+    if (m_d->outputCacheRun) {
+        ReportHandler::debugSparse(QString("%1 output cache: %2 hits, %3 misses")
+                                   .arg(name()).arg(m_d->outputCacheHits).arg(m_d->outputCacheMisses));
+        m_d->outputCache->flush();
+    }
+
+    ReportHandler::debugSparse(QString("%1 minimal constructors: %2 cached, %3 built")
+                               .arg(name()).arg(minimalConstructorCacheHits()).arg(minimalConstructorCacheMisses()));
+
+    if (!m_d->shard || (!(capabilities() & ShardedGeneration) && m_d->shard == 1)) {
+        // finishGeneration() may write files itself, with FileOut, which the archive misses.
+        QHash<QString, uint> filesBefore;
+        if (m_d->outputArchive)
+            filesBefore = fileModificationTimes(outputDirectory());
+        Profiler::Timer timer;
+        finishGeneration();
+        timer.record("finishGeneration", name());
+        if (m_d->outputArchive)
+            warnFilesWrittenToDisk(outputDirectory(), filesBefore, m_d->outputArchive->fileName());
+    } else if (capabilities() & ShardedGeneration) {
+        // finishGeneration() is called by --merge-shards with the data of all shards.
+        QFile file(shardDataFileName(m_d->shard));
+        if (file.open(QIODevice::WriteOnly)) {
+            QDataStream stream(&file);
+            stream.setVersion(QDataStream::Qt_4_5);
+            stream << name() << m_d->shardCount;
+            writeShardData(stream);
+        } else {
+            ReportHandler::warning(QString("unable to write the shard data '%1'").arg(file.fileName()));
+        }
+    }
+
+    // After finishGeneration(), so the files it writes with writeOutputFile() are recorded.
+    if (m_d->useOutputManifest && !m_d->outputManifest.save(outputManifestFileName()))
+        ReportHandler::warning(QString("unable to write the output manifest '%1'").arg(outputManifestFileName()));
+
+    if (m_d->incrementalRun)
+        writeManifest(manifestFileName(), m_d->newManifest);
+
+    commitOutputArchive();
+}
 
-        if (fileOut.done())
-            ++m_d->numGeneratedWritten;
-        ++m_d->numGenerated;
+bool Generator::mergeShards()
+{
+    // Generators that can't be sharded were run entirely by the first shard.
+    if (!(capabilities() & ShardedGeneration))
+        return true;
+
+    for (int shard = 1; shard <= m_d->mergeShardCount; ++shard) {
+        QFile file(shardDataFileName(shard));
+        if (!file.open(QIODevice::ReadOnly)) {
+            ReportHandler::warning(QString("unable to read the shard data '%1'").arg(file.fileName()));
+            return false;
+        }
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_4_5);
+        QString generatorName;
+        int shardCount;
+        stream >> generatorName >> shardCount;
+        if (generatorName != name() || shardCount != m_d->mergeShardCount) {
+            ReportHandler::warning(QString("'%1' is not the data of shard %2/%3 of %4").arg(file.fileName())
+                                   .arg(shard).arg(m_d->mergeShardCount).arg(name()));
+            return false;
+        }
+        readShardData(stream);
     }
+
+    Profiler::Timer timer;
     finishGeneration();
+    timer.record("finishGeneration", name());
+    commitOutputArchive();
+    return true;
+}
+
+void Generator::writeShardData(QDataStream&) const
+{
+}
+
+void Generator::readShardData(QDataStream&)
+{
+}
+
+void Generator::writePendingClass(int pending, const QByteArray& contents)
+{
+    writeClassFile(m_d->pendingFilePaths[pending], contents);
+    if (m_d->outputCacheRun)
+        m_d->outputCache->store(m_d->pendingCacheKeys[pending], contents);
+}
+
+static bool heavierFile(const QPair<int, QString>& a, const QPair<int, QString>& b)
+{
+    return a.first > b.first;
+}
+
+QString Generator::unityFileName(int bundle) const
+{
+    return QString("%1_unity_%2.cpp").arg(moduleName().toLower()).arg(bundle + 1);
+}
+
+/**
+ *  Writes the class files of all the generated classes in --unity-files bundles, each
+ *  one a file including them. A class keeps the bundle it got in the previous runs, so
+ *  adding or removing a class rewrites only the bundle holding it. The new
+ *  classes go, from the one with more functions, to the lightest bundle so far.
+ *  The bundles are not class files, so numGenerated() doesn't count them, and the
+ *  bundles written by a previous run with more of them are removed.
+ */
+void Generator::writeUnityFiles()
+{
+    QString bundleDirectory = outputDirectory() + '/' + subDirectoryForPackage();
+    QDir bundleDir(bundleDirectory);
+    QString stateFile = stateFileName("unity");
+    QHash<QString, QByteArray> previousBundles = readManifest(stateFile);
+
+    QVector<qint64> weights(m_d->unityFiles);
+    QVector<QStringList> bundles(m_d->unityFiles);
+    QList<QPair<int, QString> > newFiles;
+    foreach (const AbstractMetaClass* cls, classes()) {
+        if (!shouldGenerate(cls))
+            continue;
+        QString fileName = fileNameForClass(cls);
+        if (fileName.isNull())
+            continue;
+
+        QString include = bundleDir.relativeFilePath(outputDirectory() + '/' + subDirectoryForClass(cls) + '/' + fileName);
+        int weight = cls->functions().size() + 1;
+        bool ok = false;
+        int bundle = previousBundles.value(include).toInt(&ok);
+        if (ok && bundle >= 0 && bundle < m_d->unityFiles) {
+            bundles[bundle] << include;
+            weights[bundle] += weight;
+        } else {
+            newFiles << qMakePair(weight, include);
+        }
+    }
+    qStableSort(newFiles.begin(), newFiles.end(), heavierFile);
+    for (int i = 0; i < newFiles.size(); ++i) {
+        int lightest = 0;
+        for (int j = 1; j < m_d->unityFiles; ++j) {
+            if (weights[j] < weights[lightest])
+                lightest = j;
+        }
+        bundles[lightest] << newFiles[i].second;
+        weights[lightest] += newFiles[i].first;
+    }
+
+    // Besides the bundle of each class, the state keeps the names of the bundle files.
+    static const QByteArray bundleFileMark("file");
+    QHash<QString, QByteArray> state;
+    for (int bundle = 0; bundle < m_d->unityFiles; ++bundle) {
+        QStringList& includes = bundles[bundle];
+        qSort(includes);
+        CodeWriter s;
+        if (!m_d->licenseComment.isEmpty())
+            s << m_d->licenseComment << "\n\n";
+        s << "// Bundle " << (bundle + 1) << " of " << m_d->unityFiles << " of the files generated by " << name() << ".\n\n";
+        foreach (const QString& include, includes) {
+            s << "#include \"" << include << "\"\n";
+            state.insert(include, QByteArray::number(bundle));
+        }
+        state.insert(unityFileName(bundle), bundleFileMark);
+        writeOutputFile(bundleDirectory + '/' + unityFileName(bundle), s.toByteArray());
+    }
+    for (QHash<QString, QByteArray>::const_iterator it = previousBundles.constBegin(); it != previousBundles.constEnd(); ++it) {
+        if (it.value() == bundleFileMark && !state.contains(it.key()) && !m_d->outputArchive
+            && QFile::remove(bundleDirectory + '/' + it.key())) {
+            ReportHandler::debugSparse(QString("removed: %1").arg(it.key()));
+        }
+    }
+    writeManifest(stateFile, state);
+}
+
+QString Generator::stateFileName(const QString& suffix) const
+{
+    // Shards run at the same time, so each one keeps its own state.
+    if (m_d->shard)
+        return QString("%1/.%2.shard-%3-of-%4.%5").arg(outputDirectory()).arg(name())
+                      .arg(m_d->shard).arg(m_d->shardCount).arg(suffix);
+    return QString("%1/.%2.%3").arg(outputDirectory()).arg(name()).arg(suffix);
+}
+
+QString Generator::manifestFileName() const
+{
+    return stateFileName("manifest");
+}
+
+QString Generator::outputManifestFileName() const
+{
+    return stateFileName("outputs");
+}
+
+QString Generator::shardDataFileName(int shard) const
+{
+    return QString("%1/.%2.shard-%3-of-%4.data").arg(outputDirectory()).arg(name())
+                  .arg(shard).arg(m_d->shard ? m_d->shardCount : m_d->mergeShardCount);
+}
+
+void Generator::generateClasses(const QList<QPair<Generator*, int> >& tasks, int jobs)
+{
+    // The classes of thread safe generators are generated by the worker threads into their
+    // own buffers. Once the workers are done, the tasks are walked in order, generating the
+    // classes of the other generators on this thread, so they never run at the same time as
+    // the workers, and writing the buffers. The written files, the counters and the report
+    // are the ones of a serial run. Working in batches bounds the generated code held in memory.
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    const int batchSize = jobs * 4;
+    for (int first = 0; first < tasks.size(); first += batchSize) {
+        int last = qMin(first + batchSize, tasks.size());
+        QVector<CodeWriter> outputs(last - first);
+        QVector<bool> threaded(last - first);
+        for (int i = first; i < last; ++i) {
+            Generator* generator = tasks[i].first;
+            threaded[i - first] = jobs > 1 && (generator->capabilities() & ThreadSafeGeneration);
+            if (threaded[i - first]) {
+                const AbstractMetaClass* metaClass = generator->m_d->pendingClasses[tasks[i].second];
+                pool.start(new GenerateClassTask(generator, metaClass, &outputs[i - first]));
+            }
+        }
+        pool.waitForDone();
+
+        for (int i = first; i < last; ++i) {
+            Generator* generator = tasks[i].first;
+            ReportHandler::debugSparse(QString("generating: %1").arg(generator->m_d->pendingFileNames[tasks[i].second]));
+            if (!threaded[i - first])
+                GenerateClassTask(generator, generator->m_d->pendingClasses[tasks[i].second], &outputs[i - first]).run();
+            generator->writePendingClass(tasks[i].second, outputs[i - first].toByteArray());
+        }
+    }
+}
+
+bool Generator::generate()
+{
+    if (m_d->mergeShardCount)
+        return mergeShards();
+
+    beginGeneration();
+
+    int jobs = m_d->numberOfJobs;
+    if (jobs > 1 && !(capabilities() & ThreadSafeGeneration)) {
+        ReportHandler::debugSparse(QString("%1 is not thread safe, generating serially").arg(name()));
+        jobs = 1;
+    }
+
+    if (jobs == 1) {
+        for (int i = 0; i < m_d->pendingClasses.size(); ++i) {
+            ReportHandler::debugSparse(QString("generating: %1").arg(m_d->pendingFileNames[i]));
+
+            CodeWriter contents;
+            GenerateClassTask(this, m_d->pendingClasses[i], &contents).run();
+            writePendingClass(i, contents.toByteArray());
+        }
+    } else {
+        QList<QPair<Generator*, int> > tasks;
+        for (int i = 0; i < m_d->pendingClasses.size(); ++i)
+            tasks << qMakePair(this, i);
+        generateClasses(tasks, jobs);
+    }
+
+    endGeneration();
+    return true;
+}
+
+bool Generator::generate(const QLinkedList<Generator*>& generators)
+{
+    if (generators.isEmpty())
+        return true;
+
+    if (generators.first()->m_d->mergeShardCount) {
+        bool merged = true;
+        foreach (Generator* generator, generators) {
+            if (!generator->mergeShards())
+                merged = false;
+        }
+        return merged;
+    }
+
+    int jobs = 1;
+    foreach (Generator* generator, generators) {
+        generator->beginGeneration();
+        jobs = qMax(jobs, generator->m_d->numberOfJobs);
+    }
+
+    // Walk the model once, handing each class to every generator that generates it.
+    // The classes pending on each generator are in the model order.
+    QList<QPair<Generator*, int> > tasks;
+    QHash<Generator*, int> nextPending;
+    foreach (AbstractMetaClass* cls, generators.first()->classes()) {
+        foreach (Generator* generator, generators) {
+            int& next = nextPending[generator];
+            if (next < generator->m_d->pendingClasses.size() && generator->m_d->pendingClasses[next] == cls)
+                tasks << qMakePair(generator, next++);
+        }
+    }
+    generateClasses(tasks, jobs);
+
+    foreach (Generator* generator, generators)
+        generator->endGeneration();
+    return true;
 }
 
 bool Generator::shouldGenerateTypeEntry(const TypeEntry* type) const
@@ -272,73 +1645,204 @@ bool Generator::shouldGenerate(const AbstractMetaClass* metaClass) const
 
 void verifyDirectoryFor(const QFile &file)
 {
-    QDir dir = QFileInfo(file).dir();
-    if (!dir.exists()) {
-        if (!dir.mkpath(dir.absolutePath()))
-            ReportHandler::warning(QString("unable to create directory '%1'")
-                                   .arg(dir.absolutePath()));
-    }
+    QString path = QFileInfo(file).absolutePath();
+    if (!OutputQueue::makePath(path))
+        ReportHandler::warning(QString("unable to create directory '%1'").arg(path));
 }
 
-void Generator::replaceTemplateVariables(QString &code, const AbstractMetaFunction *func)
+/**
+ *  Splits a code snippet in literal text and variables. An argument variable
+ *  is a single digit, so "%12" is the first argument followed by "2".
+ */
+static CodeTemplate compileCodeTemplate(const QString& code)
 {
-    const AbstractMetaClass *cpp_class = func->ownerClass();
-    if (cpp_class)
-        code.replace("%TYPE", cpp_class->name());
+    static const struct {
+        const char* name;
+        TemplateSegment::Kind kind;
+    } variables[] = {
+        { "%TYPE", TemplateSegment::Type },
+        { "%RETURN_TYPE", TemplateSegment::ReturnType },
+        { "%FUNCTION_NAME", TemplateSegment::FunctionName },
+        { "%ARGUMENT_NAMES", TemplateSegment::ArgumentNames },
+        { "%ARGUMENTS", TemplateSegment::Arguments }
+    };
+
+    CodeTemplate result;
+    result.literalSize = 0;
+    int literalStart = 0;
+    for (int i = 0; i < code.size(); ++i) {
+        if (code[i] != '%')
+            continue;
 
-    foreach (AbstractMetaArgument *arg, func->arguments())
-        code.replace("%" + QString::number(arg->argumentIndex() + 1), arg->name());
+        TemplateSegment variable;
+        variable.argument = 0;
+        int length = 0;
+        if (i + 1 < code.size() && code[i + 1] >= '1' && code[i + 1] <= '9') {
+            variable.kind = TemplateSegment::Argument;
+            variable.argument = code[i + 1].digitValue();
+            length = 2;
+        } else {
+            for (uint v = 0; v < sizeof(variables) / sizeof(variables[0]); ++v) {
+                int nameLength = qstrlen(variables[v].name);
+                if (code.mid(i, nameLength) == QLatin1String(variables[v].name)) {
+                    variable.kind = variables[v].kind;
+                    length = nameLength;
+                    break;
+                }
+            }
+        }
+        if (!length)
+            continue;
 
-    //template values
-    code.replace("%RETURN_TYPE", translateType(func->type(), cpp_class));
-    code.replace("%FUNCTION_NAME", func->originalName());
+        if (i > literalStart) {
+            TemplateSegment literal;
+            literal.kind = TemplateSegment::Literal;
+            literal.text = code.mid(literalStart, i - literalStart);
+            literal.argument = 0;
+            result.segments << literal;
+            result.literalSize += literal.text.size();
+        }
+        variable.text = code.mid(i, length);
+        result.segments << variable;
+        i += length - 1;
+        literalStart = i + 1;
+    }
+    if (literalStart < code.size()) {
+        TemplateSegment literal;
+        literal.kind = TemplateSegment::Literal;
+        literal.text = code.mid(literalStart);
+        literal.argument = 0;
+        result.segments << literal;
+        result.literalSize += literal.text.size();
+    }
+    return result;
+}
 
-    if (code.contains("%ARGUMENT_NAMES")) {
-        QString str;
-        QTextStream aux_stream(&str);
-        writeArgumentNames(aux_stream, func, Generator::SkipRemovedArguments);
-        code.replace("%ARGUMENT_NAMES", str);
+void Generator::replaceTemplateVariables(QString &code, const AbstractMetaFunction *func)
+{
+    // Snippets are injected in many functions, so each one is compiled only once.
+    CodeTemplate codeTemplate;
+    bool compiled;
+    {
+        QReadLocker locker(&m_d->codeTemplatesLock);
+        QHash<QString, CodeTemplate>::const_iterator it = m_d->codeTemplates.constFind(code);
+        compiled = it != m_d->codeTemplates.constEnd();
+        if (compiled)
+            codeTemplate = it.value();
+    }
+    if (!compiled) {
+        codeTemplate = compileCodeTemplate(code);
+        QWriteLocker locker(&m_d->codeTemplatesLock);
+        m_d->codeTemplates.insert(code, codeTemplate);
+    }
+    if (codeTemplate.segments.isEmpty()
+        || (codeTemplate.segments.size() == 1 && codeTemplate.segments.first().kind == TemplateSegment::Literal)) {
+        return;
     }
 
-    if (code.contains("%ARGUMENTS")) {
-        QString str;
-        QTextStream aux_stream(&str);
-        writeFunctionArguments(aux_stream, func, Options(SkipDefaultValues) | SkipRemovedArguments);
-        code.replace("%ARGUMENTS", str);
+    const AbstractMetaClass *cpp_class = func->ownerClass();
+    AbstractMetaArgumentList arguments;
+    QString returnType;
+    QString argumentNames;
+    QString functionArguments;
+    bool argumentsListed = false;
+    bool returnTypeTranslated = false;
+    bool argumentNamesWritten = false;
+    bool functionArgumentsWritten = false;
+
+    QString result;
+    result.reserve(codeTemplate.literalSize + 32 * codeTemplate.segments.size());
+    foreach (const TemplateSegment& segment, codeTemplate.segments) {
+        switch (segment.kind) {
+        case TemplateSegment::Literal:
+            result += segment.text;
+            break;
+        case TemplateSegment::Type:
+            result += cpp_class ? cpp_class->name() : segment.text;
+            break;
+        case TemplateSegment::Argument: {
+            if (!argumentsListed) {
+                arguments = func->arguments();
+                argumentsListed = true;
+            }
+            const AbstractMetaArgument* argument = 0;
+            foreach (const AbstractMetaArgument* arg, arguments) {
+                if (arg->argumentIndex() + 1 == segment.argument) {
+                    argument = arg;
+                    break;
+                }
+            }
+            result += argument ? argument->name() : segment.text;
+            break;
+        }
+        case TemplateSegment::ReturnType:
+            if (!returnTypeTranslated) {
+                returnType = translateType(func->type(), cpp_class);
+                returnTypeTranslated = true;
+            }
+            result += returnType;
+            break;
+        case TemplateSegment::FunctionName:
+            result += func->originalName();
+            break;
+        case TemplateSegment::ArgumentNames:
+            if (!argumentNamesWritten) {
+                QTextStream aux_stream(&argumentNames);
+                writeArgumentNames(aux_stream, func, Generator::SkipRemovedArguments);
+                argumentNamesWritten = true;
+            }
+            result += argumentNames;
+            break;
+        case TemplateSegment::Arguments:
+            if (!functionArgumentsWritten) {
+                QTextStream aux_stream(&functionArguments);
+                writeFunctionArguments(aux_stream, func, Options(SkipDefaultValues) | SkipRemovedArguments);
+                functionArgumentsWritten = true;
+            }
+            result += functionArguments;
+            break;
+        }
     }
+    code = result;
 }
 
 QTextStream& formatCode(QTextStream &s, const QString& code, Indentor &indentor)
 {
+    const QChar* begin = code.constData();
+    const QChar* end = begin + code.size();
+
     // detect number of spaces before the first character
-    QStringList lst(code.split("\n"));
-    QRegExp nonSpaceRegex("[^\\s]");
     int spacesToRemove = 0;
-    foreach(QString line, lst) {
-        if (!line.trimmed().isEmpty()) {
-            spacesToRemove = line.indexOf(nonSpaceRegex);
-            if (spacesToRemove == -1)
-                spacesToRemove = 0;
+    for (const QChar* c = begin; c != end; ++c) {
+        if (!c->isSpace()) {
+            const QChar* lineStart = c;
+            while (lineStart != begin && lineStart[-1] != '\n')
+                --lineStart;
+            spacesToRemove = c - lineStart;
             break;
         }
     }
 
-    static QRegExp emptyLine("\\s*[\\r]?[\\n]?\\s*");
-
-    foreach(QString line, lst) {
-        if (!line.isEmpty() && !emptyLine.exactMatch(line)) {
-            while (line.end()->isSpace())
-                line.chop(1);
-            int limit = 0;
-            for(int i = 0; i < spacesToRemove; ++i) {
-                if (!line[i].isSpace())
-                    break;
-                limit++;
-            }
+    const QChar* lineStart = begin;
+    forever {
+        const QChar* lineEnd = lineStart;
+        bool blank = true;
+        for (; lineEnd != end && *lineEnd != '\n'; ++lineEnd) {
+            if (blank && !lineEnd->isSpace())
+                blank = false;
+        }
 
-            s << indentor << line.remove(0, limit);
+        if (!blank) {
+            const QChar* text = lineStart;
+            while (text - lineStart < spacesToRemove && text->isSpace())
+                ++text;
+            s << indentor << QString::fromRawData(text, lineEnd - text);
         }
-        s << endl;
+        s << '\n';
+
+        if (lineEnd == end)
+            break;
+        lineStart = lineEnd + 1;
     }
     return s;
 }
@@ -346,7 +1850,7 @@ QTextStream& formatCode(QTextStream &s, const QString& code, Indentor &indentor)
 AbstractMetaFunctionList Generator::implicitConversions(const TypeEntry* type) const
 {
     if (type->isValue()) {
-        const AbstractMetaClass* metaClass = classes().findClass(type);
+        const AbstractMetaClass* metaClass = findClass(type);
         if (metaClass)
             return metaClass->implicitConversions();
     }
@@ -400,28 +1904,49 @@ bool Generator::isVoidPointer(const AbstractMetaType* type)
 
 QString Generator::getFullTypeName(const TypeEntry* type) const
 {
-    return QString("%1%2").arg(type->isCppPrimitive() ? "" : "::").arg(type->qualifiedCppName());
+    SymbolTable* symbols = SymbolTable::instance();
+    int symbol = symbols->findName(SymbolTable::FullTypeName, type);
+    if (symbol < 0) {
+        QString name = type->qualifiedCppName();
+        if (!type->isCppPrimitive())
+            name.prepend("::");
+        symbol = symbols->addName(SymbolTable::FullTypeName, type, QString(), name);
+    }
+    return symbols->name(symbol);
 }
 
 QString Generator::getFullTypeName(const AbstractMetaType* type) const
 {
-    if (isCString(type))
-        return "const char*";
-    if (isVoidPointer(type))
-        return "void*";
-    if (type->typeEntry()->isContainer())
-        return QString("::%1").arg(type->cppSignature());
+    SymbolTable* symbols = SymbolTable::instance();
+    QString signature = type->cppSignature();
+    int symbol = symbols->findName(SymbolTable::FullTypeName, type->typeEntry(), signature);
+    if (symbol >= 0)
+        return symbols->name(symbol);
+
     QString typeName;
-    if (type->typeEntry()->isComplex() && type->hasInstantiations())
-        typeName = getFullTypeNameWithoutModifiers(type);
-    else
-        typeName = getFullTypeName(type->typeEntry());
-    return typeName + QString("*").repeated(type->indirections());
+    if (isCString(type)) {
+        typeName = "const char*";
+    } else if (isVoidPointer(type)) {
+        typeName = "void*";
+    } else if (type->typeEntry()->isContainer()) {
+        typeName = "::" + signature;
+    } else {
+        if (type->typeEntry()->isComplex() && type->hasInstantiations())
+            typeName = getFullTypeNameWithoutModifiers(type);
+        else
+            typeName = getFullTypeName(type->typeEntry());
+        typeName += QString(type->indirections(), '*');
+    }
+    return symbols->name(symbols->addName(SymbolTable::FullTypeName, type->typeEntry(), signature, typeName));
 }
 
 QString Generator::getFullTypeName(const AbstractMetaClass* metaClass) const
 {
-    return QString("::%1").arg(metaClass->qualifiedCppName());
+    SymbolTable* symbols = SymbolTable::instance();
+    int symbol = symbols->findName(SymbolTable::FullTypeName, metaClass);
+    if (symbol < 0)
+        symbol = symbols->addName(SymbolTable::FullTypeName, metaClass, QString(), "::" + metaClass->qualifiedCppName());
+    return symbols->name(symbol);
 }
 
 QString Generator::getFullTypeNameWithoutModifiers(const AbstractMetaType* type) const
@@ -432,27 +1957,55 @@ QString Generator::getFullTypeNameWithoutModifiers(const AbstractMetaType* type)
         return "void*";
     if (!type->hasInstantiations())
         return getFullTypeName(type->typeEntry());
+
+    SymbolTable* symbols = SymbolTable::instance();
     QString typeName = type->cppSignature();
-    if (type->isConstant())
-        typeName.remove(0, sizeof("const ") / sizeof(char) - 1);
-    if (type->isReference())
-        typeName.chop(1);
-    while (typeName.endsWith('*') || typeName.endsWith(' '))
-        typeName.chop(1);
-    return QString("::%1").arg(typeName);
+    int symbol = symbols->findName(SymbolTable::FullTypeNameWithoutModifiers, type->typeEntry(), typeName);
+    if (symbol < 0) {
+        int start = type->isConstant() ? constPrefixLength : 0;
+        int end = typeName.size();
+        if (type->isReference())
+            --end;
+        while (end > start && (typeName[end - 1] == '*' || typeName[end - 1] == ' '))
+            --end;
+        symbol = symbols->addName(SymbolTable::FullTypeNameWithoutModifiers, type->typeEntry(), typeName,
+                                  "::" + typeName.midRef(start, end - start).toString());
+    }
+    return symbols->name(symbol);
 }
 
 QString Generator::minimalConstructor(const AbstractMetaType* type) const
 {
-    if (!type || (type->isReference() && Generator::isObjectType(type)))
+    if (!type)
+        return QString();
+
+    QMutexLocker locker(&m_d->minimalConstructorMutex);
+    QPair<const TypeEntry*, QString> key(type->typeEntry(), type->cppSignature());
+    QHash<QPair<const TypeEntry*, QString>, QString>::const_iterator it = m_d->metaTypeConstructors.constFind(key);
+    if (it != m_d->metaTypeConstructors.constEnd()) {
+        ++m_d->minimalConstructorCacheHits;
+        return it.value();
+    }
+    ++m_d->minimalConstructorCacheMisses;
+
+    int state = m_d->beginMinimalConstructor();
+    QString ctor = buildMinimalConstructor(type);
+    if (m_d->endMinimalConstructor(state))
+        m_d->metaTypeConstructors.insert(key, ctor);
+    return ctor;
+}
+
+QString Generator::buildMinimalConstructor(const AbstractMetaType* type) const
+{
+    if (type->isReference() && Generator::isObjectType(type))
         return QString();
 
     if (type->isContainer()) {
         QString ctor = type->cppSignature();
         if (ctor.endsWith("*"))
             return QString("0");
-        if (ctor.startsWith("const "))
-            ctor.remove(0, sizeof("const ") / sizeof(char) - 1);
+        if (ctor.startsWith(constPrefix))
+            ctor.remove(0, constPrefixLength);
         if (ctor.endsWith("&")) {
             ctor.chop(1);
             ctor = ctor.trimmed();
@@ -471,7 +2024,7 @@ QString Generator::minimalConstructor(const AbstractMetaType* type) const
         QString ctor = cType->defaultConstructor();
         if (!ctor.isEmpty())
             return ctor;
-        ctor = minimalConstructor(classes().findClass(cType));
+        ctor = minimalConstructor(findClass(cType));
         if (type->hasInstantiations())
             ctor = ctor.replace(getFullTypeName(cType), getFullTypeNameWithoutModifiers(type));
         return ctor;
@@ -485,6 +2038,23 @@ QString Generator::minimalConstructor(const TypeEntry* type) const
     if (!type)
         return QString();
 
+    QMutexLocker locker(&m_d->minimalConstructorMutex);
+    QHash<const TypeEntry*, QString>::const_iterator it = m_d->typeEntryConstructors.constFind(type);
+    if (it != m_d->typeEntryConstructors.constEnd()) {
+        ++m_d->minimalConstructorCacheHits;
+        return it.value();
+    }
+    ++m_d->minimalConstructorCacheMisses;
+
+    int state = m_d->beginMinimalConstructor();
+    QString ctor = buildMinimalConstructor(type);
+    if (m_d->endMinimalConstructor(state))
+        m_d->typeEntryConstructors.insert(type, ctor);
+    return ctor;
+}
+
+QString Generator::buildMinimalConstructor(const TypeEntry* type) const
+{
     if (type->isCppPrimitive())
         return QString("((%1)0)").arg(type->qualifiedCppName());
 
@@ -501,7 +2071,7 @@ QString Generator::minimalConstructor(const TypeEntry* type) const
     }
 
     if (type->isComplex())
-        return minimalConstructor(classes().findClass(type));
+        return minimalConstructor(findClass(type));
 
     return QString();
 }
@@ -511,6 +2081,44 @@ QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
     if (!metaClass)
         return QString();
 
+    QMutexLocker locker(&m_d->minimalConstructorMutex);
+    QHash<const AbstractMetaClass*, QString>::const_iterator it = m_d->classConstructors.constFind(metaClass);
+    if (it != m_d->classConstructors.constEnd()) {
+        ++m_d->minimalConstructorCacheHits;
+        return it.value();
+    }
+
+    int cycleStart = m_d->classesInProgress.indexOf(metaClass);
+    if (cycleStart != -1) {
+        // The class constructor can't be built using the class itself.
+        m_d->minimalConstructorCycleCut = qMin(m_d->minimalConstructorCycleCut, cycleStart);
+        return QString();
+    }
+    ++m_d->minimalConstructorCacheMisses;
+
+    int state = m_d->beginMinimalConstructor();
+    m_d->classesInProgress << metaClass;
+    QString ctor = buildMinimalConstructor(metaClass);
+    m_d->classesInProgress.removeLast();
+    if (m_d->endMinimalConstructor(state))
+        m_d->classConstructors.insert(metaClass, ctor);
+    return ctor;
+}
+
+int Generator::minimalConstructorCacheHits() const
+{
+    QMutexLocker locker(&m_d->minimalConstructorMutex);
+    return m_d->minimalConstructorCacheHits;
+}
+
+int Generator::minimalConstructorCacheMisses() const
+{
+    QMutexLocker locker(&m_d->minimalConstructorMutex);
+    return m_d->minimalConstructorCacheMisses;
+}
+
+QString Generator::buildMinimalConstructor(const AbstractMetaClass* metaClass) const
+{
     const ComplexTypeEntry* cType = reinterpret_cast<const ComplexTypeEntry*>(metaClass->typeEntry());
     if (cType->hasDefaultConstructor())
         return cType->defaultConstructor();
@@ -614,9 +2222,63 @@ QString Generator::minimalConstructor(const AbstractMetaClass* metaClass) const
     return QString();
 }
 
+/**
+ *  Returns the C++ signature of a type without its constness and/or reference,
+ *  as the signature of a copy of the type without them would be, or a null
+ *  string if the signature hasn't the expected layout.
+ */
+static QString strippedSignature(const AbstractMetaType* type, bool excludeConst, bool excludeReference)
+{
+    QString signature = type->cppSignature();
+    if (excludeConst && type->isConstant()) {
+        if (!signature.startsWith(constPrefix))
+            return QString();
+        signature.remove(0, constPrefixLength);
+    }
+    if (excludeReference && type->isReference()) {
+        if (!signature.endsWith('&'))
+            return QString();
+        signature.chop(1);
+        // A space separates the type from its indirections and reference.
+        if (signature.endsWith(' '))
+            signature.chop(1);
+    }
+    return signature;
+}
+
 QString Generator::translateType(const AbstractMetaType *cType,
                                  const AbstractMetaClass *context,
                                  Options options) const
+{
+    // Without stripping or the original name the translation is the signature the type
+    // already keeps, which is cheaper to return than to look up.
+    if (!cType || !(options & (ExcludeConst | ExcludeReference | OriginalName)))
+        return translateTypeUncached(cType, context, options);
+
+    TranslatedTypeKey key = { cType, context, int(options) };
+    {
+        QReadLocker locker(&m_d->translatedTypesLock);
+        QHash<TranslatedTypeKey, TranslatedType>::const_iterator it = m_d->translatedTypes.constFind(key);
+        if (it != m_d->translatedTypes.constEnd() && it->cppSignature == cType->cppSignature()
+            && (!(options & OriginalName) || it->originalTypeDescription == cType->originalTypeDescription())) {
+            return it->translation;
+        }
+    }
+
+    TranslatedType translated;
+    translated.cppSignature = cType->cppSignature();
+    if (options & OriginalName)
+        translated.originalTypeDescription = cType->originalTypeDescription();
+    translated.translation = translateTypeUncached(cType, context, options);
+
+    QWriteLocker locker(&m_d->translatedTypesLock);
+    m_d->translatedTypes.insert(key, translated);
+    return translated.translation;
+}
+
+QString Generator::translateTypeUncached(const AbstractMetaType *cType,
+                                         const AbstractMetaClass *context,
+                                         Options options) const
 {
     QString s;
     static int constLen = strlen("const");
@@ -647,18 +2309,21 @@ QString Generator::translateType(const AbstractMetaType *cType,
                     s = s.remove(index, constLen);
             }
         } else if (options & Generator::ExcludeConst || options & Generator::ExcludeReference) {
-            AbstractMetaType* copyType = cType->copy();
+            s = strippedSignature(cType, options & Generator::ExcludeConst, options & Generator::ExcludeReference);
+            if (s.isNull()) {
+                AbstractMetaType* copyType = cType->copy();
 
-            if (options & Generator::ExcludeConst)
-                copyType->setConstant(false);
+                if (options & Generator::ExcludeConst)
+                    copyType->setConstant(false);
 
-            if (options & Generator::ExcludeReference)
-                copyType->setReference(false);
+                if (options & Generator::ExcludeReference)
+                    copyType->setReference(false);
 
-            s = copyType->cppSignature();
-            if (!copyType->typeEntry()->isVoid() && !copyType->typeEntry()->isCppPrimitive())
+                s = copyType->cppSignature();
+                delete copyType;
+            }
+            if (!cType->typeEntry()->isVoid() && !cType->typeEntry()->isCppPrimitive())
                 s.prepend("::");
-            delete copyType;
         } else {
             s = cType->cppSignature();
         }
@@ -681,28 +2346,40 @@ QString Generator::subDirectoryForPackage(QString packageName) const
 }
 
 template<typename T>
-static QString getClassTargetFullName_(const T* t, bool includePackageName)
+static int getClassTargetFullName_(const T* t, bool includePackageName)
 {
+    SymbolTable* symbols = SymbolTable::instance();
+    SymbolTable::NameKind kind = includePackageName ? SymbolTable::TargetFullName : SymbolTable::TargetName;
+    int symbol = symbols->findName(kind, t);
+    if (symbol >= 0)
+        return symbol;
+
+    // The name of the enclosing class is interned too, so it is built only once.
     QString name = t->name();
     const AbstractMetaClass* context = t->enclosingClass();
-    while (context) {
-        name.prepend('.');
-        name.prepend(context->name());
-        context = context->enclosingClass();
-    }
-    if (includePackageName) {
-        name.prepend('.');
-        name.prepend(t->package());
-    }
-    return name;
+    if (context)
+        name = symbols->name(getClassTargetFullName_(context, false)) + '.' + name;
+    if (includePackageName)
+        name = t->package() + '.' + name;
+    return symbols->addName(kind, t, QString(), name);
 }
 
 QString getClassTargetFullName(const AbstractMetaClass* metaClass, bool includePackageName)
 {
-    return getClassTargetFullName_(metaClass, includePackageName);
+    return SymbolTable::instance()->name(getClassTargetFullName_(metaClass, includePackageName));
 }
 
 QString getClassTargetFullName(const AbstractMetaEnum* metaEnum, bool includePackageName)
+{
+    return SymbolTable::instance()->name(getClassTargetFullName_(metaEnum, includePackageName));
+}
+
+int getClassTargetFullNameSymbol(const AbstractMetaClass* metaClass, bool includePackageName)
+{
+    return getClassTargetFullName_(metaClass, includePackageName);
+}
+
+int getClassTargetFullNameSymbol(const AbstractMetaEnum* metaEnum, bool includePackageName)
 {
     return getClassTargetFullName_(metaEnum, includePackageName);
 }
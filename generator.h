@@ -27,12 +27,16 @@
 #include <QtCore/QObject>
 #include <QtCore/QDir>
 #include <QtCore/QLinkedList>
+#include <QtCore/QPair>
 #include <abstractmetalang.h>
 #include "generatorrunnermacros.h"
+#include "codewriter.h"
+#include "symboltable.h"
 
 class ApiExtractor;
 class AbstractMetaBuilder;
 class QFile;
+class QDataStream;
 
 #define EXPORT_GENERATOR_PLUGIN(X)\
 extern "C" GENRUNNER_EXPORT void getGenerators(GeneratorList* list)\
@@ -47,6 +51,12 @@ void verifyDirectoryFor(const QFile &file);
 
 GENRUNNER_API QString getClassTargetFullName(const AbstractMetaClass* metaClass, bool includePackageName = true);
 GENRUNNER_API QString getClassTargetFullName(const AbstractMetaEnum* metaEnum, bool includePackageName = true);
+/**
+ *   Returns the SymbolTable symbol of getClassTargetFullName(), for comparing names without
+ *   comparing strings. Symbols are valid while the generators set up with the model are alive.
+ */
+GENRUNNER_API int getClassTargetFullNameSymbol(const AbstractMetaClass* metaClass, bool includePackageName = true);
+GENRUNNER_API int getClassTargetFullNameSymbol(const AbstractMetaEnum* metaEnum, bool includePackageName = true);
 
 /**
  *   Base class for all generators. The default implementations does nothing,
@@ -94,6 +104,27 @@ public:
     };
     Q_DECLARE_FLAGS(Options, Option)
 
+    /// Features a generator declares to the runner
+    enum Capability {
+        NoCapabilities           = 0x00000000,
+        ThreadSafeGeneration     = 0x00000001,
+        IncrementalGeneration    = 0x00000002,
+        ShardedGeneration        = 0x00000004,
+        UnityGeneration          = 0x00000008
+    };
+    Q_DECLARE_FLAGS(Capabilities, Capability)
+
+    /**
+     *   Where a container instantiation is used: the return value or an argument of
+     *   a function, or a field. The class is 0 for global functions.
+     */
+    struct ContainerUse
+    {
+        const AbstractMetaClass* metaClass;
+        const AbstractMetaFunction* function;
+        const AbstractMetaField* field;
+    };
+
     Generator();
     virtual ~Generator();
 
@@ -101,20 +132,58 @@ public:
 
     virtual QMap<QString, QString> options() const;
 
-    /// Returns the classes used to generate the binding code.
-    AbstractMetaClassList classes() const;
+    /**
+     *   Returns the features supported by the generator. The default implementation
+     *   returns NoCapabilities.
+     *   A generator declaring ThreadSafeGeneration allows generateClass() to be
+     *   called for several classes at the same time; it must not change its own
+     *   state nor use ReportHandler from there. The generation threads share the
+     *   model: the signatures of its types and functions are built before they start,
+     *   but any other model data computed on first use must not be asked for there.
+     *   A generator declaring IncrementalGeneration allows generateClass() to be
+     *   skipped for the classes whose fingerprint did not change since the last run,
+     *   so the code generated for a class must depend only on what classFingerprint()
+     *   takes into account, and finishGeneration() must not rely on generateClass().
+     *   A generator declaring ShardedGeneration allows its classes to be split among
+     *   several runs with --shard; what generateClass() collects for finishGeneration()
+     *   must be saved by writeShardData() and merged back by readShardData().
+     *   Generators without it are run entirely by the first shard.
+     *   A generator declaring UnityGeneration writes class files that are C++ sources
+     *   which can be compiled together, so --unity-files can bundle them.
+     */
+    virtual Capabilities capabilities() const;
+
+    /**
+     *   Returns the classes used to generate the binding code. This and the other model
+     *   lists are taken from APIExtractor once by setup(), so they can be used in loops
+     *   and by several threads without copying them.
+     */
+    const AbstractMetaClassList& classes() const;
+
+    /**
+     *   Find a class in classes() without scanning them, using indexes built by setup().
+     *   When several classes match, the first one in classes() is returned. Returns 0
+     *   if no class matches.
+     */
+    AbstractMetaClass* findClass(const TypeEntry* typeEntry) const;
+    /// Finds a class by its qualified C++ name, e.g. "Namespace::Class".
+    AbstractMetaClass* findClassByCppName(const QString& qualifiedCppName) const;
+    /// Finds a class by its qualified target language name, e.g. "Package.Class".
+    AbstractMetaClass* findClassByTargetLangName(const QString& qualifiedTargetLangName) const;
+    /// Finds a class by its unqualified name.
+    AbstractMetaClass* findClassByName(const QString& name) const;
 
     /// Returns all global functions found by APIExtractor
-    AbstractMetaFunctionList globalFunctions() const;
+    const AbstractMetaFunctionList& globalFunctions() const;
 
     /// Returns all global enums found by APIExtractor
-    AbstractMetaEnumList globalEnums() const;
+    const AbstractMetaEnumList& globalEnums() const;
 
     /// Returns all primitive types found by APIExtractor
-    QList<const PrimitiveTypeEntry*> primitiveTypes() const;
+    const QList<const PrimitiveTypeEntry*>& primitiveTypes() const;
 
     /// Returns all container types found by APIExtractor
-    QList<const ContainerTypeEntry*> containerTypes() const;
+    const QList<const ContainerTypeEntry*>& containerTypes() const;
 
     /// Returns an AbstractMetaEnum for a given EnumTypeEntry, or NULL if not found.
     const AbstractMetaEnum* findAbstractMetaEnum(const EnumTypeEntry* typeEntry) const;
@@ -136,11 +205,44 @@ public:
 
     /**
     *   Start the code generation, be sure to call setClasses before callign this method.
-    *   For each class it creates a QTextStream, call the write method with the current
-    *   class and the associated text stream, then write the text stream contents if needed.
+    *   For each class it creates a CodeWriter, call generateClassCode() with the current
+    *   class and the associated writer, then write the writer contents if needed.
+    *   Returns false if the generation failed, like when --merge-shards can't read
+    *   the data of a shard.
     *   \see #write
     */
-    void generate();
+    bool generate();
+
+    /**
+    *   Generates the code of several generators walking the classes only once: each class
+    *   is handed to all the generators before moving to the next one. The classes of thread
+    *   safe generators are generated concurrently when they were set to use more than one job.
+    *   All the generators must be already set up with the same ApiExtractor.
+    *   Returns false if the generation of any of them failed.
+    */
+    static bool generate(const QLinkedList<Generator*>& generators);
+
+    /// Returns the file name of the plugin library that provides the generator
+    QString pluginFileName() const;
+
+    /// Sets the file name of the plugin library that provides the generator
+    void setPluginFileName(const QString& fileName);
+
+    /**
+     *   Sets a digest of the contents of the files read to build the model: the global
+     *   header with the headers it includes and the typesystem files. The --output-cache
+     *   keys include it, since a class file may depend on any part of the model.
+     */
+    void setInputContentsDigest(const QByteArray& digest);
+
+    /// Returns the number of threads used to generate the classes
+    int numberOfJobs() const;
+
+    /**
+    *   Sets the number of threads used to generate the classes. Generators without
+    *   the ThreadSafeGeneration capability are always run serially.
+    */
+    void setNumberOfJobs(int jobs);
 
     /// Returns the number of generated items
     int numGenerated() const;
@@ -148,6 +250,35 @@ public:
     /// Returns the number of generated items written
     int numGeneratedAndWritten() const;
 
+    /**
+     *   Records a file read by the generator besides the header and the typesystems,
+     *   like documentation and code snippets, so it is listed by --depfile and an edit
+     *   of it is seen by the next run with --model-cache.
+     *   Can be called by the generation threads.
+     */
+    void addInputFile(const QString& fileName);
+
+    /// Returns the files recorded by addInputFile().
+    QStringList inputFiles() const;
+
+    /**
+     *   Records an output file written by the generator itself, like the ones written
+     *   by finishGeneration(), so it is listed by --changed-files. The class files are
+     *   recorded by generate() when they are written.
+     */
+    void addChangedFile(const QString& fileName);
+
+    /// Returns the output files written by the generation, the unchanged ones excluded.
+    QStringList changedFiles() const;
+
+    /**
+     *   Writes a file generated outside generateClass(), like the ones of finishGeneration(),
+     *   unless it already has the same contents, and records it with addChangedFile().
+     *   With --output-archive the files of the output directory go into the archive instead.
+     *   Returns true if the file was written. Can be called by the generation threads.
+     */
+    bool writeOutputFile(const QString& fileName, const QByteArray& contents);
+
     /// Returns the generator's name. Used for cosmetic purposes.
     virtual const char* name() const = 0;
 
@@ -166,6 +297,8 @@ public:
     *   \param context the current meta class
     *   \param option some extra options
     *   \return the metatype translated to binding source format
+    *   The translations stripping the constness or the reference, or using the original
+    *   name, are cached until the next setup().
     */
     QString translateType(const AbstractMetaType *metatype,
                           const AbstractMetaClass *context,
@@ -206,6 +339,12 @@ public:
      */
     QString packageName() const;
 
+    /**
+     *   Returns the names of all the packages generated in this run, when several
+     *   typesystems generate code. The first one is packageName().
+     */
+    QStringList packageNames() const;
+
     /**
      *  Retrieves the name of the currently processed module.
      *  While package name is a complete package idetification, e.g. 'PySide.QtCore',
@@ -242,7 +381,7 @@ public:
     /// Returns true if the type is a void pointer.
     static bool isVoidPointer(const AbstractMetaType* type);
 
-    // Returns the full name of the type.
+    // Returns the full name of the type, interned in the SymbolTable.
     QString getFullTypeName(const TypeEntry* type) const;
     QString getFullTypeName(const AbstractMetaType* type) const;
     QString getFullTypeName(const AbstractMetaClass* metaClass) const;
@@ -258,10 +397,17 @@ public:
      *   Tries to build a minimal constructor for the type.
      *   It will check first for a user defined default constructor.
      *   Returns a null string if it fails.
+     *   Results are cached until the next setup(). A class whose constructor needs,
+     *   through its arguments, a constructor of itself is not built that way.
      */
     QString minimalConstructor(const TypeEntry* type) const;
     QString minimalConstructor(const AbstractMetaType* type) const;
     QString minimalConstructor(const AbstractMetaClass* metaClass) const;
+
+    /// Returns how many minimalConstructor() calls were answered by its cache.
+    int minimalConstructorCacheHits() const;
+    /// Returns how many minimalConstructor() calls had to build the constructor.
+    int minimalConstructorCacheMisses() const;
 protected:
     /**
      *   Returns the file name used to write the binding code of an AbstractMetaClass.
@@ -274,6 +420,30 @@ protected:
 
     virtual bool doSetup(const QMap<QString, QString>& args) = 0;
 
+    /**
+     *   Returns a fingerprint of everything used to generate the code of an AbstractMetaClass:
+     *   its functions, fields, enums and type system modifications, the ones of its base
+     *   classes and of the classes, enums and types its functions and fields use, the
+     *   arguments of the run that can change the generated code, the license comment and
+     *   the generator plugin. The incremental generation skips the classes whose fingerprint
+     *   is the one stored in the manifest of the last run.
+     *   Generators using other inputs must reimplement this method to add them.
+     */
+    virtual QByteArray classFingerprint(const AbstractMetaClass* metaClass) const;
+
+    /**
+     *   Saves what the generateClass() calls of a shard collected for finishGeneration().
+     *   Only called for generators declaring ShardedGeneration. Does nothing by default.
+     */
+    virtual void writeShardData(QDataStream& stream) const;
+
+    /**
+     *   Merges the data saved by writeShardData() in a shard, before finishGeneration()
+     *   is called by --merge-shards. Called once for each shard, in the shards order.
+     *   Does nothing by default.
+     */
+    virtual void readShardData(QDataStream& stream);
+
     /**
      *   Write the bindding code for an AbstractMetaClass.
      *   This is called by generate method.
@@ -281,6 +451,13 @@ protected:
      *   \param  metaClass  the class that should be generated
      */
     virtual void generateClass(QTextStream& s, const AbstractMetaClass* metaClass) = 0;
+
+    /**
+     *   Writes the code of an AbstractMetaClass as UTF-8. This is what generate() calls;
+     *   by default it calls generateClass() with a CodeWriterStream. Generators that write
+     *   to the CodeWriter directly avoid the QTextStream encoding.
+     */
+    virtual void generateClassCode(CodeWriter& writer, const AbstractMetaClass* metaClass);
     virtual void finishGeneration() = 0;
 
     /**
@@ -294,57 +471,57 @@ protected:
     */
     virtual QString subDirectoryForPackage(QString packageName = QString()) const;
 
+    /**
+     *   Returns the name of the \p bundle (from 0) file written by --unity-files, which
+     *   is placed in the package directory. The default is "<module>_unity_<bundle + 1>.cpp".
+     */
+    virtual QString unityFileName(int bundle) const;
+
     QList<const AbstractMetaType*> instantiatedContainers() const;
 
+    /**
+     *   Returns where the container instantiation named \p containerName, as returned
+     *   by getSimplifiedContainerTypeName(), is used by the generated classes and the
+     *   global functions, in the order they were found. A function using the container
+     *   more than once is listed once.
+     */
+    QList<ContainerUse> containerUses(const QString& containerName) const;
+
+    /// Returns the names of the container instantiations used by a class functions and fields.
+    QStringList containersUsedBy(const AbstractMetaClass* metaClass) const;
+
     static QString getSimplifiedContainerTypeName(const AbstractMetaType* type);
     void addInstantiatedContainers(const AbstractMetaType* type);
 
 private:
+    friend class GenerateClassTask;
     struct GeneratorPrivate;
     GeneratorPrivate* m_d;
-    void collectInstantiatedContainers(const AbstractMetaFunction* func);
-    void collectInstantiatedContainers(const AbstractMetaClass* metaClass);
+    void beginGeneration();
+    void endGeneration();
+    QString manifestFileName() const;
+    QString outputManifestFileName() const;
+    QString stateFileName(const QString& suffix) const;
+    QString shardDataFileName(int shard) const;
+    bool mergeShards();
+    void writeUnityFiles();
+    void writeClassFile(const QString& fileName, const QByteArray& contents);
+    void writePendingClass(int pending, const QByteArray& contents);
+    void commitOutputArchive();
+    QByteArray classContentsDigest(const AbstractMetaClass* metaClass) const;
+    static void generateClasses(const QList<QPair<Generator*, int> >& tasks, int jobs);
+    void addInstantiatedContainer(const AbstractMetaType* type, const ContainerUse& use);
     void collectInstantiatedContainers();
+    void buildClassIndexes();
+    QString translateTypeUncached(const AbstractMetaType* metatype, const AbstractMetaClass* context, Options options) const;
+    QString buildMinimalConstructor(const TypeEntry* type) const;
+    QString buildMinimalConstructor(const AbstractMetaType* type) const;
+    QString buildMinimalConstructor(const AbstractMetaClass* metaClass) const;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Generator::Options)
+Q_DECLARE_OPERATORS_FOR_FLAGS(Generator::Capabilities)
 typedef QLinkedList<Generator*> GeneratorList;
 
-/**
-* Utility class to store the identation level, use it in a QTextStream.
-*/
-class GENRUNNER_API Indentor
-{
-public:
-    Indentor() : indent(0) {}
-    int indent;
-};
-
-/**
-*   Class that use the RAII idiom to set and unset the identation level.
-*/
-class GENRUNNER_API Indentation
-{
-public:
-    Indentation(Indentor &indentor) : indentor(indentor)
-    {
-        indentor.indent++;
-    }
-    ~Indentation()
-    {
-        indentor.indent--;
-    }
-
-private:
-    Indentor &indentor;
-};
-
-GENRUNNER_API inline QTextStream &operator <<(QTextStream &s, const Indentor &indentor)
-{
-    for (int i = 0; i < indentor.indent; ++i)
-        s << "    ";
-    return s;
-}
-
 #endif // GENERATOR_H
 
@@ -27,12 +27,13 @@
 #include <doxygenparser.h>
 #include <typedatabase.h>
 #include <algorithm>
+#include <QtCore/QDataStream>
 #include <QtCore/QStack>
 #include <QtCore/QTextStream>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QDir>
-#include <fileout.h>
 #include <limits>
 
 EXPORT_GENERATOR_PLUGIN(new QtDocGenerator)
@@ -196,13 +197,7 @@ QString QtXmlToSphinx::expandFunction(const QString& function)
 {
     QStringList functionSpec = function.split('.');
     QString className = functionSpec.first();
-    const AbstractMetaClass* metaClass = 0;
-    foreach (const AbstractMetaClass* cls, m_generator->classes()) {
-        if (cls->name() == className) {
-            metaClass = cls;
-            break;
-        }
-    }
+    const AbstractMetaClass* metaClass = m_generator->findClassByName(className);
 
     if (metaClass) {
         functionSpec.removeFirst();
@@ -216,13 +211,7 @@ QString QtXmlToSphinx::resolveContextForMethod(const QString& methodName)
 {
     QString currentClass = m_context.split(".").last();
 
-    const AbstractMetaClass* metaClass = 0;
-    foreach (const AbstractMetaClass* cls, m_generator->classes()) {
-        if (cls->name() == currentClass) {
-            metaClass = cls;
-            break;
-        }
-    }
+    const AbstractMetaClass* metaClass = m_generator->findClassByName(currentClass);
 
     if (metaClass) {
         QList<const AbstractMetaFunction*> funcList;
@@ -314,6 +303,7 @@ QString QtXmlToSphinx::readFromLocation(const QString& location, const QString&
             *ok = false;
         return QString();
     }
+    m_generator->addInputFile(QFileInfo(inputFile).absoluteFilePath());
 
     QRegExp searchString("//!\\s*\\[" + identifier + "\\]");
     QRegExp codeSnippetCode("//!\\s*\\[[\\w\\d\\s]+\\]");
@@ -1549,8 +1539,9 @@ void QtDocGenerator::finishGeneration()
     QMap<QString, QStringList>::iterator it = m_packages.begin();
     for (; it != m_packages.end(); ++it) {
         QString outputDir = outputDirectory() + '/' + QString(it.key()).replace(".", "/");
-        FileOut output(outputDir + "/index.rst");
-        QTextStream& s = output.stream;
+        // Encoded as FileOut did, like the class files.
+        CodeWriter contents;
+        CodeWriterStream s(contents);
 
         s << ".. module:: " << it.key() << endl << endl;
 
@@ -1570,12 +1561,12 @@ void QtDocGenerator::finishGeneration()
                 QString origFileName(*it2);
                 it2->remove(0, it.key().count() + 1);
                 QString newFilePath = outputDir + '/' + *it2;
-                if (QFile::exists(newFilePath))
-                    QFile::remove(newFilePath);
-                if (!QFile::copy(m_extraSectionDir + '/' + origFileName, newFilePath)) {
-                    ReportHandler::warning("Error copying extra doc " + (m_extraSectionDir + '/' + origFileName)
-                                           + " to " + newFilePath);
-                }
+                QFile extraSection(m_extraSectionDir + '/' + origFileName);
+                addInputFile(QFileInfo(extraSection).absoluteFilePath());
+                if (extraSection.open(QIODevice::ReadOnly))
+                    writeOutputFile(newFilePath, extraSection.readAll());
+                else
+                    ReportHandler::warning("Error copying extra doc " + extraSection.fileName() + " to " + newFilePath);
             }
             it.value().append(fileList);
         }
@@ -1599,6 +1590,7 @@ void QtDocGenerator::finishGeneration()
         // module doc is always wrong and C++istic, so go straight to the extra directory!
         QFile moduleDoc(m_extraSectionDir + '/' + it.key() + ".rst");
         if (moduleDoc.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            addInputFile(QFileInfo(moduleDoc).absoluteFilePath());
             s << moduleDoc.readAll();
             moduleDoc.close();
         } else {
@@ -1611,6 +1603,35 @@ void QtDocGenerator::finishGeneration()
                 s << moduleDoc.value();
             }
         }
+
+        s.flush();
+        writeOutputFile(outputDir + "/index.rst", contents.toByteArray());
+    }
+}
+
+void QtDocGenerator::writeShardData(QDataStream& stream) const
+{
+    stream << m_packages;
+}
+
+void QtDocGenerator::readShardData(QDataStream& stream)
+{
+    QMap<QString, QStringList> packages;
+    stream >> packages;
+    QMap<QString, QStringList>::const_iterator it = packages.constBegin();
+    for (; it != packages.constEnd(); ++it)
+        m_packages[it.key()] << it.value();
+
+    // Keep the classes in the model order, as a run without shards does.
+    QHash<QString, int> classOrder;
+    foreach (const AbstractMetaClass* metaClass, classes())
+        classOrder.insert(fileNameForClass(metaClass), classOrder.size());
+    QMap<QString, QStringList>::iterator packageIt = m_packages.begin();
+    for (; packageIt != m_packages.end(); ++packageIt) {
+        QMap<int, QString> orderedFiles;
+        foreach (const QString& fileName, packageIt.value())
+            orderedFiles.insert(classOrder.value(fileName), fileName);
+        packageIt.value() = orderedFiles.values();
     }
 }
 
@@ -1636,6 +1657,9 @@ bool QtDocGenerator::doSetup(const QMap<QString, QString>& args)
     } else {
         m_docParser->setDocumentationDataDirectory(m_docDataDir);
         m_docParser->setLibrarySourceDirectory(m_libSourceDir);
+        // The parsers pick the files of each class by their own rules, so all are inputs.
+        foreach (const QFileInfo& docFile, QDir(m_docDataDir).entryInfoList(QDir::Files))
+            addInputFile(docFile.absoluteFilePath());
     }
     return true;
 }
@@ -180,6 +180,11 @@ public:
 
     QMap<QString, QString> options() const;
 
+    Capabilities capabilities() const
+    {
+        return ShardedGeneration;
+    }
+
     QStringList codeSnippetDirs() const
     {
         return m_codeSnippetDirs;
@@ -189,6 +194,8 @@ protected:
     QString fileNameForClass(const AbstractMetaClass* cppClass) const;
     void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
     void finishGeneration();
+    void writeShardData(QDataStream& stream) const;
+    void readShardData(QDataStream& stream);
 
     void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
     void writeArgumentNames(QTextStream&, const AbstractMetaFunction*, Options) const {}
@@ -0,0 +1,318 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "generatorserver.h"
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QProcess>
+#include <QtCore/QTextCodec>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+static bool writeAll(int fd, const char* data, qint64 size)
+{
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, qint64 size)
+{
+    while (size > 0) {
+        ssize_t bytesRead = ::read(fd, data, size);
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            return false;
+        data += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+static bool socketAddress(const QString& socketName, sockaddr_un* address)
+{
+    QByteArray path = QFile::encodeName(socketName);
+    if (path.size() >= int(sizeof(address->sun_path)))
+        return false;
+    memset(address, 0, sizeof(sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path.constData());
+    return true;
+}
+
+// A request is the size of the serialized string list followed by the list itself.
+// The arguments and the environment of a job are far smaller than the size limit.
+static const quint32 maxRequestSize = 16 * 1024 * 1024;
+
+static bool sendRequest(int fd, const QStringList& request)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << quint32(0) << request;
+    stream.device()->seek(0);
+    stream << quint32(data.size() - sizeof(quint32));
+    return writeAll(fd, data.constData(), data.size());
+}
+
+static bool receiveRequest(int fd, QStringList* request)
+{
+    QByteArray data(sizeof(quint32), '\0');
+    if (!readAll(fd, data.data(), data.size()))
+        return false;
+    quint32 size;
+    QDataStream(data) >> size;
+    if (size > maxRequestSize)
+        return false;
+    data.resize(size);
+    if (!readAll(fd, data.data(), size))
+        return false;
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream >> *request;
+    return stream.status() == QDataStream::Ok;
+}
+
+// The output of a job ends with this marker followed by the exit code as a 32 bit
+// big endian integer, so a connection dropped before the end is told apart.
+static const char exitCodeMarker[] = { '\0', 'G', 'R', 'X' };
+static const int exitCodeTrailerSize = sizeof(exitCodeMarker) + 4;
+
+static void sendExitCode(int fd, int exitCode)
+{
+    char trailer[exitCodeTrailerSize];
+    memcpy(trailer, exitCodeMarker, sizeof(exitCodeMarker));
+    for (int i = 0; i < 4; ++i)
+        trailer[sizeof(exitCodeMarker) + i] = char(quint32(exitCode) >> (24 - i * 8));
+    writeAll(fd, trailer, exitCodeTrailerSize);
+}
+
+/// Replaces the environment of the process with the client's one, given as NAME=value strings.
+static void setEnvironment(const QStringList& environment)
+{
+    QList<QByteArray> names;
+    for (char** variable = environ; *variable; ++variable) {
+        QByteArray entry(*variable);
+        names << entry.left(entry.indexOf('='));
+    }
+    foreach (const QByteArray& name, names)
+        unsetenv(name.constData());
+    foreach (const QString& variable, environment) {
+        int separator = variable.indexOf('=');
+        if (separator > 0)
+            setenv(variable.left(separator).toLocal8Bit().constData(), variable.mid(separator + 1).toLocal8Bit().constData(), 1);
+    }
+
+    // The locale was set up by the server with its own environment.
+    setlocale(LC_ALL, "");
+    QTextCodec::setCodecForLocale(0);
+}
+
+/**
+ *   Runs a job in a child process with the client's environment, writing its output
+ *   to the client socket, then sends its exit code, the last bytes the client receives.
+ */
+static void handleJob(int fd, const QStringList& environment, const QStringList& arguments, RunJobFunction runJob)
+{
+    pid_t job = fork();
+    if (job == 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        ::close(fd);
+        setEnvironment(environment);
+        int exitCode = runJob(arguments);
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(0);
+        _exit(exitCode);
+    }
+
+    int status = 0;
+    int exitCode = EXIT_FAILURE;
+    if (job > 0 && waitpid(job, &status, 0) == job && WIFEXITED(status))
+        exitCode = WEXITSTATUS(status);
+    else if (job < 0)
+        writeAll(fd, "Unable to start the job\n", 24);
+    else
+        writeAll(fd, "The job crashed\n", 16);
+    sendExitCode(fd, exitCode);
+}
+
+int runGeneratorServer(const QString& socketName, PrepareJobFunction prepareJob, RunJobFunction runJob)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketName, &address)) {
+        std::cerr << "Socket name too long: " << qPrintable(socketName) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(address.sun_path);
+    if (serverFd < 0 || bind(serverFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || listen(serverFd, 16)) {
+        std::cerr << "Unable to listen on " << qPrintable(socketName) << ": " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Listening on " << qPrintable(socketName) << std::endl;
+
+    // The processes handling the jobs are reaped automatically.
+    signal(SIGCHLD, SIG_IGN);
+    QString serverDir = QDir::currentPath();
+    forever {
+        int fd = accept(serverFd, 0, 0);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Unable to accept jobs: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        // The first string is the client working directory, the second the number of
+        // variables of its environment, which follow, and the others its command line.
+        QStringList request;
+        bool validRequest = receiveRequest(fd, &request) && request.size() >= 3;
+        int environmentSize = validRequest ? request[1].toInt(&validRequest) : 0;
+        if (!validRequest || environmentSize < 0 || request.size() < environmentSize + 3) {
+            ::close(fd);
+            continue;
+        }
+        QString workDir = request.takeFirst();
+        request.removeFirst();
+        QStringList environment = request.mid(0, environmentSize);
+        request = request.mid(environmentSize);
+        if (!QDir::setCurrent(workDir)) {
+            QByteArray message = "Unable to enter the directory " + QFile::encodeName(workDir) + '\n';
+            writeAll(fd, message.constData(), message.size());
+            sendExitCode(fd, EXIT_FAILURE);
+            ::close(fd);
+            continue;
+        }
+
+        prepareJob(request);
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(0);
+        pid_t handler = fork();
+        if (handler == 0) {
+            ::close(serverFd);
+            signal(SIGCHLD, SIG_DFL);
+            handleJob(fd, environment, request, runJob);
+            _exit(EXIT_SUCCESS);
+        } else if (handler < 0) {
+            sendExitCode(fd, EXIT_FAILURE);
+        }
+        ::close(fd);
+        QDir::setCurrent(serverDir);
+    }
+    ::close(serverFd);
+    return EXIT_FAILURE;
+}
+
+bool forwardToGeneratorServer(const QString& socketName, const QStringList& arguments, int* exitCode)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketName, &address))
+        return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    QStringList environment = QProcess::systemEnvironment();
+    QStringList request;
+    request << QDir::currentPath() << QString::number(environment.size()) << environment << arguments;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || !sendRequest(fd, request)) {
+        ::close(fd);
+        return false;
+    }
+
+    // The output is passed through as it arrives, holding back the last bytes
+    // received, which are the exit code once the server closes the connection.
+    char buffer[4096];
+    QByteArray pending;
+    bool received = false;
+    forever {
+        ssize_t bytesRead = ::read(fd, buffer, sizeof(buffer));
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            break;
+        pending.append(buffer, bytesRead);
+        if (pending.size() > exitCodeTrailerSize) {
+            fwrite(pending.constData(), 1, pending.size() - exitCodeTrailerSize, stdout);
+            fflush(stdout);
+            pending.remove(0, pending.size() - exitCodeTrailerSize);
+        }
+        received = true;
+    }
+    ::close(fd);
+    if (!received)
+        return false;
+
+    if (pending.size() == exitCodeTrailerSize && pending.startsWith(QByteArray(exitCodeMarker, sizeof(exitCodeMarker)))) {
+        quint32 code = 0;
+        for (int i = sizeof(exitCodeMarker); i < exitCodeTrailerSize; ++i)
+            code = (code << 8) | static_cast<unsigned char>(pending[i]);
+        *exitCode = int(code);
+    } else {
+        fwrite(pending.constData(), 1, pending.size(), stdout);
+        fflush(stdout);
+        std::cerr << "Lost the connection to the generator server" << std::endl;
+        *exitCode = EXIT_FAILURE;
+    }
+    return true;
+}
+
+#else
+
+int runGeneratorServer(const QString&, PrepareJobFunction, RunJobFunction)
+{
+    std::cerr << "The generator server is not supported on this platform" << std::endl;
+    return EXIT_FAILURE;
+}
+
+bool forwardToGeneratorServer(const QString&, const QStringList&, int*)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GENERATORSERVER_H
+#define GENERATORSERVER_H
+
+#include <QtCore/QStringList>
+
+typedef void (*PrepareJobFunction)(const QStringList& arguments);
+typedef int (*RunJobFunction)(const QStringList& arguments);
+
+/**
+ *   Listens on the Unix domain socket \p socketName for jobs sent by
+ *   forwardToGeneratorServer(). Each job is a command line run in the client's
+ *   working directory: \p prepareJob is called with it in the server process, to
+ *   keep what can be reused warm, then \p runJob runs it in a forked process, with
+ *   the client's environment, whose output and exit code are sent back to the client.
+ *   Only returns on errors.
+ */
+int runGeneratorServer(const QString& socketName, PrepareJobFunction prepareJob, RunJobFunction runJob);
+
+/**
+ *   Sends a command line and the environment to the server listening on \p socketName,
+ *   passing its output through to the standard output and setting \p exitCode, which
+ *   is EXIT_FAILURE if the connection is lost before the job ends. Returns false
+ *   if no server took the job, which should then be run by the caller.
+ */
+bool forwardToGeneratorServer(const QString& socketName, const QStringList& arguments, int* exitCode);
+
+#endif // GENERATORSERVER_H
@@ -25,10 +25,19 @@
 #include <QLinkedList>
 #include <QLibrary>
 #include <QDomDocument>
+#include <QThread>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QXmlStreamReader>
 #include <iostream>
 #include <apiextractor.h>
 #include "generatorrunnerconfig.h"
 #include "generator.h"
+#include "generatorserver.h"
+#include "outputarchive.h"
+#include "outputcache.h"
+#include "profiler.h"
 
 #ifdef _WINDOWS
     #define PATH_SPLITTER ";"
@@ -99,10 +108,9 @@ static bool processProjectFile(QFile& projectFile, QMap<QString, QString>& args)
     return true;
 }
 
-static QMap<QString, QString> getInitializedArguments()
+static QMap<QString, QString> getInitializedArguments(QStringList arguments)
 {
     QMap<QString, QString> args;
-    QStringList arguments = QCoreApplication::arguments();
     QString appName = arguments.first();
     arguments.removeFirst();
 
@@ -140,10 +148,9 @@ static QMap<QString, QString> getInitializedArguments()
     return args;
 }
 
-static QMap<QString, QString> getCommandLineArgs()
+static QMap<QString, QString> getCommandLineArgs(QStringList arguments)
 {
-    QMap<QString, QString> args = getInitializedArguments();
-    QStringList arguments = QCoreApplication::arguments();
+    QMap<QString, QString> args = getInitializedArguments(arguments);
     arguments.removeFirst();
 
     int argNum = 0;
@@ -165,6 +172,312 @@ static QMap<QString, QString> getCommandLineArgs()
     return args;
 }
 
+static QString findFile(const QString& fileName, const QStringList& searchPaths)
+{
+    if (fileName.isEmpty())
+        return QString();
+    if (QFileInfo(fileName).isAbsolute())
+        return QFile::exists(fileName) ? fileName : QString();
+    foreach (const QString& path, searchPaths) {
+        QFileInfo candidate(QDir(path), fileName);
+        if (candidate.exists())
+            return candidate.absoluteFilePath();
+    }
+    return QString();
+}
+
+/**
+ *  Collects the header file and all headers included by it that can be found in
+ *  the header own directory or in the include paths. Headers that can't be found,
+ *  like the system ones, are not part of the closure.
+ */
+static void collectHeaderClosure(const QString& fileName, const QStringList& includePaths, QSet<QString>& files)
+{
+    if (fileName.isEmpty() || files.contains(fileName))
+        return;
+    files << fileName;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QRegExp includeRegex("^\\s*#\\s*include\\s*[<\"]([^>\"]+)[>\"]");
+    QStringList searchPaths = QStringList() << QFileInfo(fileName).absolutePath() << includePaths;
+    while (!file.atEnd()) {
+        QString line = file.readLine();
+        if (includeRegex.indexIn(line) != -1)
+            collectHeaderClosure(findFile(includeRegex.cap(1), searchPaths), includePaths, files);
+    }
+}
+
+/// Collects the typesystem file and all the typesystems loaded by it.
+static void collectTypesystemClosure(const QString& fileName, const QStringList& typesystemPaths, QSet<QString>& files)
+{
+    if (fileName.isEmpty() || files.contains(fileName))
+        return;
+    files << fileName;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QXmlStreamReader reader(&file);
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement && reader.name() == "load-typesystem") {
+            QString name = reader.attributes().value("name").toString();
+            collectTypesystemClosure(findFile(name, QStringList() << "." << typesystemPaths), typesystemPaths, files);
+        }
+    }
+}
+
+/**
+ *  Returns the input files of a run that are known before parsing: the closure of the
+ *  global header, the typesystem files and the generator-set plugin.
+ */
+static QSet<QString> runInputFiles(const QMap<QString, QString>& args, const QString& pluginFileName)
+{
+    QSet<QString> files;
+    files << pluginFileName;
+    QStringList includePaths = args.value("include-paths").split(PATH_SPLITTER, QString::SkipEmptyParts);
+    collectHeaderClosure(findFile(args.value("arg-1"), QStringList() << "."), includePaths, files);
+    QStringList typesystemPaths = args.value("typesystem-paths").split(PATH_SPLITTER, QString::SkipEmptyParts);
+    collectTypesystemClosure(findFile(args.value("arg-2"), QStringList() << "."), typesystemPaths, files);
+    return files;
+}
+
+/**
+ *  Returns a key identifying the configuration of a run: the generator-set plugin, the
+ *  license comment and the arguments. Each configuration keeps one file in the model cache.
+ */
+static QByteArray runConfigurationKey(const QMap<QString, QString>& args, const QString& pluginFileName,
+                                      const QString& licenseComment)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(GENERATORRUNNER_VERSION);
+    hash.addData(pluginFileName.toUtf8());
+    hash.addData(licenseComment.toUtf8());
+
+    QMap<QString, QString>::const_iterator it = args.constBegin();
+    for (; it != args.constEnd(); ++it) {
+        if (it.key() != "model-cache")
+            hash.addData(QString("\n%1=%2").arg(it.key()).arg(it.value()).toUtf8());
+    }
+    return hash.result().toHex();
+}
+
+/**
+ *  Returns a digest of the contents of the inputs of a run: the closure of the global
+ *  header, the typesystem files, the generator-set plugin and the \p generatorInputFiles
+ *  read by the generators. Reading them is much cheaper than parsing them, and unlike
+ *  their modification times it can't miss an edit.
+ */
+static QByteArray runInputDigest(const QMap<QString, QString>& args, const QString& pluginFileName,
+                                 const QStringList& generatorInputFiles)
+{
+    QStringList sortedFiles = (runInputFiles(args, pluginFileName) + generatorInputFiles.toSet()).toList();
+    qSort(sortedFiles);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QString& fileName, sortedFiles) {
+        hash.addData(fileName.toUtf8());
+        hash.addData("\0", 1);
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly)) {
+            while (!file.atEnd())
+                hash.addData(file.read(64 * 1024));
+        }
+        hash.addData("\0", 1);
+    }
+    return hash.result().toHex();
+}
+
+/// Returns the SHA-1 of the contents of a file, hex encoded.
+static QByteArray fileContentsDigest(const QString& fileName)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)) {
+        while (!file.atEnd())
+            hash.addData(file.read(64 * 1024));
+    }
+    return hash.result().toHex();
+}
+
+/**
+ *  Returns a digest of the contents of the inputs of a run, like runInputDigest(), but
+ *  without their paths, so build trees of the same sources share the --output-cache.
+ */
+static QByteArray runContentsDigest(const QMap<QString, QString>& args, const QString& pluginFileName)
+{
+    QStringList fileDigests;
+    foreach (const QString& fileName, runInputFiles(args, pluginFileName))
+        fileDigests << fileContentsDigest(fileName);
+    qSort(fileDigests);
+    return QCryptographicHash::hash(fileDigests.join("\n").toAscii(), QCryptographicHash::Sha1).toHex();
+}
+
+/// Returns the size and modification time of an output file, as kept in the model cache.
+static QByteArray outputFileState(const QFileInfo& info)
+{
+    return QString("%1 %2").arg(info.size()).arg(info.lastModified().toTime_t()).toUtf8();
+}
+
+/**
+ *  Reads the files the generators reported with Generator::addInputFile() in the run
+ *  recorded by the model cache file \p fileName. They are only known after generating,
+ *  so the next run takes them from there.
+ */
+static QStringList readModelCacheInputFiles(const QString& fileName)
+{
+    QStringList inputFiles;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return inputFiles;
+    file.readLine();
+    int count = file.readLine().trimmed().toInt();
+    for (int i = 0; i < count && !file.atEnd(); ++i)
+        inputFiles << QString::fromUtf8(file.readLine()).remove('\n');
+    return inputFiles;
+}
+
+/**
+ *  Tells if the model cache file \p fileName records a run with the inputs of \p inputDigest
+ *  whose output files are all still there, unchanged.
+ */
+static bool isModelCacheHit(const QString& fileName, const QByteArray& inputDigest)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text) || file.readLine().trimmed() != inputDigest)
+        return false;
+    // The input files of the generators.
+    int count = file.readLine().trimmed().toInt();
+    for (int i = 0; i < count && !file.atEnd(); ++i)
+        file.readLine();
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        if (line.endsWith('\n'))
+            line.chop(1);
+        // Each line has the size, the modification time and the path of a file.
+        int split = line.indexOf(' ', line.indexOf(' ') + 1);
+        QFileInfo info(QString::fromUtf8(line.mid(split + 1)));
+        if (split < 0 || !info.exists() || outputFileState(info) != line.left(split))
+            return false;
+    }
+    return true;
+}
+
+// Keys not written for this long belong to configurations that are not used anymore.
+static const int modelCacheExpiryDays = 30;
+
+/**
+ *  Records in the model cache file \p fileName the digest of the inputs of a successful
+ *  run, the \p generatorInputFiles it covers and the state of the files in its output
+ *  directory, then removes the keys of the configurations not run for a while. The
+ *  ApiExtractor logs and the \p runFiles, like the depfile, are rewritten by every run
+ *  and left out.
+ */
+static bool writeModelCache(const QString& fileName, const QByteArray& inputDigest,
+                            const QStringList& generatorInputFiles, const QString& outputDirectory,
+                            const QStringList& runFiles)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    file.write(inputDigest + '\n');
+    file.write(QByteArray::number(generatorInputFiles.size()) + '\n');
+    foreach (const QString& inputFile, generatorInputFiles)
+        file.write(inputFile.toUtf8() + '\n');
+    QString cacheDirectory = QFileInfo(fileName).absolutePath();
+    QString absoluteOutputDirectory = QFileInfo(outputDirectory).absoluteFilePath();
+    QSet<QString> skippedFiles;
+    foreach (const QString& runFile, runFiles)
+        skippedFiles << QFileInfo(runFile).absoluteFilePath();
+    QDirIterator it(outputDirectory, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        if (info.absolutePath() == cacheDirectory || skippedFiles.contains(info.absoluteFilePath()))
+            continue;
+        if (info.absolutePath() == absoluteOutputDirectory && info.suffix() == "log")
+            continue;
+        file.write(outputFileState(info) + ' ' + info.filePath().toUtf8() + '\n');
+    }
+    file.close();
+
+    QDateTime expiry = QDateTime::currentDateTime().addDays(-modelCacheExpiryDays);
+    foreach (const QFileInfo& info, QDir(cacheDirectory).entryInfoList(QDir::Files)) {
+        if (info.lastModified() < expiry)
+            QFile::remove(info.filePath());
+    }
+    return true;
+}
+
+/// Escapes a file name for a Make or Ninja depfile.
+static QString depFilePath(QString path)
+{
+    return path.replace(' ', "\\ ").replace('#', "\\#").replace('$', "$$");
+}
+
+/// Writes a Make and Ninja depfile telling that \p target depends on \p files.
+static bool writeDepFile(const QString& fileName, const QString& target, const QSet<QString>& files)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QStringList sortedFiles = files.toList();
+    qSort(sortedFiles);
+    QTextStream s(&file);
+    s << depFilePath(target) << ':';
+    foreach (const QString& input, sortedFiles)
+        s << " \\\n  " << depFilePath(input);
+    s << '\n';
+    return true;
+}
+
+/// Writes the list of \p files, one per line.
+static bool writeFileList(const QString& fileName, QStringList files)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    qSort(files);
+    QTextStream s(&file);
+    foreach (const QString& name, files)
+        s << name << '\n';
+    return true;
+}
+
+/**
+ *  Runs --extract-archive: writes the files of an --output-archive into the output
+ *  directory, leaving alone the ones that already have the same contents.
+ */
+static int extractArchive(const QString& appName, const QMap<QString, QString>& args)
+{
+    QString archiveFileName = args.value("extract-archive");
+    OutputArchiveReader archive;
+    if (!archive.open(archiveFileName)) {
+        std::cerr << qPrintable(appName) << ": Can't read the output archive " << qPrintable(archiveFileName);
+        std::cerr << ": " << qPrintable(archive.errorString()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    QString outputDirectory = args.contains("output-directory") ? args["output-directory"] : "out";
+    int jobs = args.value("jobs").isEmpty() ? QThread::idealThreadCount() : args.value("jobs").toInt();
+    QStringList writtenFiles;
+    if (!archive.extract(outputDirectory, jobs, &writtenFiles)) {
+        std::cerr << qPrintable(appName) << ": Can't extract the output archive " << qPrintable(archiveFileName);
+        std::cerr << ": " << qPrintable(archive.errorString()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    QString changedFilesFileName = args.value("changed-files");
+    if (!changedFilesFileName.isEmpty() && !writeFileList(changedFilesFileName, writtenFiles))
+        ReportHandler::warning("Can't write the changed files list: " + changedFilesFileName);
+
+    ReportHandler::flush();
+    std::cout << "Done, " << writtenFiles.size() << " of " << archive.count() << " files written" << std::endl;
+    return EXIT_SUCCESS;
+}
+
 void printUsage(const GeneratorList& generators)
 {
     QTextStream s(stdout);
@@ -185,6 +498,26 @@ void printUsage(const GeneratorList& generators)
     generalOptions.insert("version", "Output version information and exit");
     generalOptions.insert("generator-set=<\"generator module\">", "generator-set to be used. e.g. qtdoc");
     generalOptions.insert("api-version=<\"package mask\">,<\"version\">", "Specify the supported api version used to generate the bindings");
+    generalOptions.insert("incremental", "Only generate the classes changed since the last run. Ignored by generators that do not support it");
+    generalOptions.insert("model-cache=<dir>", "Directory where the keys of the inputs of successful runs are kept. When all inputs, including the files read by the generators, are the same of the previous run with the same options, and its output files were not changed, the parsing and the generation are skipped");
+    generalOptions.insert("single-pass", "Set up all the generators of the generator-set first, then walk the classes once handing each one to every generator");
+    generalOptions.insert("shard=<shard>/<number of shards>", "Generate only a part of the classes, numbered from 1, balanced by their number of functions. The final step is left to --merge-shards");
+    generalOptions.insert("merge-shards=<number of shards>", "Do the final step of the generators with the data saved by each shard");
+    generalOptions.insert("server=<socket>", "Stay resident, running the jobs sent by generatorrunner instances given the same socket with --server-socket");
+    generalOptions.insert("server-socket=<socket>", "Send the run to the generatorrunner server listening on the socket, running it here when no server is listening");
+    generalOptions.insert("depfile=<file>", "Write a Make and Ninja depfile with all the files read by the run: the headers, the typesystems, the license file, the generator-set plugin and the files read by the generators. Needs --changed-files, the target of the rule");
+    generalOptions.insert("changed-files=<file>", "Write the list of the output files that were rewritten by the run, one per line");
+    generalOptions.insert("unity-files=<number>", "Also write the class files in the given number of files including them, balanced by their number of functions, for unity builds. Ignored by generators whose class files are not C++ sources");
+    generalOptions.insert("output-cache=<dir>", "Directory where the generated files are cached by everything used to generate them, including the contents of the headers and typesystem files, to be shared by the runs of several build trees. Ignored by generators that do not support incremental generation");
+    generalOptions.insert("output-cache-size=<megabytes>", "Maximum size of the output cache, defaults to 1024. The least recently used files are removed when it grows over it");
+    generalOptions.insert("output-cache-stats", "Print the hits, misses, evictions and size of the output cache and exit");
+    generalOptions.insert("output-archive=<file>", "Write the generated files into the given archive instead of the output directory. Implies --no-output-manifest, and --incremental is ignored. Can't be used with --shard or --merge-shards");
+    generalOptions.insert("extract-archive=<file>", "Write the files of an archive made with --output-archive into the output directory, only the ones whose contents changed, removing the ones extracted before that it doesn't have anymore, and exit");
+    generalOptions.insert("profile=<file>", "Write the wall and CPU time spent in each phase of the run to the given file, in JSON");
+    generalOptions.insert("no-output-manifest", "Do not keep the digests of the generated files, always reading them back to know if they changed");
+    generalOptions.insert("output-threads=<number>", "Number of background threads writing the generated files. By default the files are written by the generating thread");
+    generalOptions.insert("output-queue-limit=<megabytes>", "Maximum amount of generated code waiting for the output threads, defaults to 64");
+    generalOptions.insert("jobs[=<number>]", "Number of threads used to generate the classes, defaults to the number of processors. Ignored by generators that are not thread safe");
     generalOptions.insert("drop-type-entries=\"<TypeEntry0>[;TypeEntry1;...]\"", "Semicolon separated list of type system entries (classes, namespaces, global functions and enums) to be dropped from generation.");
     printOptions(s, generalOptions);
 
@@ -197,59 +530,170 @@ void printUsage(const GeneratorList& generators)
     }
 }
 
-int main(int argc, char *argv[])
+/// Returns the generator-set given in the arguments, if any.
+static QString generatorSetName(const QMap<QString, QString>& args)
 {
-    // needed by qxmlpatterns
-    QCoreApplication app(argc, argv);
+    QString generatorSet = args.value("generator-set");
+
+    // Also check "generatorSet" command line argument for backward compatibility.
+    if (generatorSet.isEmpty())
+        generatorSet = args.value("generatorSet");
+    return generatorSet;
+}
+
+/// Finds the plugin of a generator-set given by its file name or by its name.
+static QFileInfo findGeneratorSet(const QString& generatorSet)
+{
+    QFileInfo generatorFile(generatorSet);
+
+    if (!generatorFile.exists()) {
+        QString generatorSetName(generatorSet + "_generator" + MODULE_EXTENSION);
+
+        // More library paths may be added via the QT_PLUGIN_PATH environment variable. It is
+        // read again since a server job gets its environment after the library paths were set.
+        QCoreApplication::addLibraryPath(GENERATORRUNNER_PLUGIN_DIR);
+        QStringList paths = QString::fromLocal8Bit(qgetenv("QT_PLUGIN_PATH")).split(PATH_SPLITTER, QString::SkipEmptyParts);
+        foreach (const QString& path, QCoreApplication::libraryPaths()) {
+            if (!paths.contains(path))
+                paths << path;
+        }
+        foreach (const QString& path, paths) {
+            generatorFile.setFile(QDir(path), generatorSetName);
+            if (generatorFile.exists())
+                break;
+        }
+    }
+    return generatorFile;
+}
+
+struct PreloadedGeneratorSet
+{
+    QLibrary* library;
+    QByteArray digest;
+};
+
+// The plugins loaded by the server, by file name, with the digest of the loaded contents.
+static QHash<QString, PreloadedGeneratorSet> preloadedGeneratorSets;
+
+/**
+ *  Loads the generator-set plugin of a server job in the server process, where it
+ *  stays loaded, so the forked process running the job finds it already in memory.
+ *  A plugin rebuilt since it was loaded is unloaded first, otherwise loading it again
+ *  would return the old code still in memory.
+ */
+static void preloadGeneratorSet(const QStringList& arguments)
+{
+    QString generatorSet = generatorSetName(getCommandLineArgs(arguments));
+    if (generatorSet.isEmpty())
+        return;
+    QFileInfo generatorFile = findGeneratorSet(generatorSet);
+    if (!generatorFile.exists())
+        return;
+
+    QString fileName = generatorFile.absoluteFilePath();
+    QByteArray digest = fileContentsDigest(fileName);
+    QHash<QString, PreloadedGeneratorSet>::iterator it = preloadedGeneratorSets.find(fileName);
+    if (it != preloadedGeneratorSets.end()) {
+        if (it->digest == digest)
+            return;
+        if (!it->library->unload()) {
+            std::cerr << "The generator-set plugin " << qPrintable(fileName)
+                      << " changed but can't be unloaded, restart the server to use it" << std::endl;
+            return;
+        }
+        delete it->library;
+        preloadedGeneratorSets.erase(it);
+    }
+
+    PreloadedGeneratorSet preloaded;
+    preloaded.library = new QLibrary(fileName);
+    preloaded.digest = digest;
+    if (preloaded.library->load())
+        preloadedGeneratorSets.insert(fileName, preloaded);
+    else
+        delete preloaded.library;
+}
+
+/// Runs the generators with the given command line, the program name being the first argument.
+static int runGenerators(const QStringList& arguments)
+{
+    QString appName = arguments.first();
+
+    Profiler::Timer runTimer;
 
     // Store command arguments in a map
-    QMap<QString, QString> args = getCommandLineArgs();
+    Profiler::Timer argumentsTimer;
+    QMap<QString, QString> args = getCommandLineArgs(arguments);
     GeneratorList generators;
 
+    QString profileFileName = args.value("profile");
+    QString depFileName = args.value("depfile");
+    QString changedFilesFileName = args.value("changed-files");
+    Profiler::setEnabled(!profileFileName.isEmpty());
+    argumentsTimer.record("parseArguments", args.value("project-file"));
+
     if (args.contains("version")) {
         std::cout << "generatorrunner v" GENERATORRUNNER_VERSION << std::endl;
         std::cout << "Copyright (C) 2009-2010 Nokia Corporation and/or its subsidiary(-ies)" << std::endl;
         return EXIT_SUCCESS;
     }
 
-    // Try to load a generator
-    QString generatorSet = args.value("generator-set");
-
-    // Also check "generatorSet" command line argument for backward compatibility.
-    if (generatorSet.isEmpty())
-        generatorSet = args.value("generatorSet");
+    // The changed files list is rewritten by every run, so it is the target of the depfile.
+    // The output directory isn't: its time stamp doesn't change when only files are rewritten.
+    if (!depFileName.isEmpty() && changedFilesFileName.isEmpty()) {
+        std::cerr << qPrintable(appName) << ": --depfile needs the target given with --changed-files" << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    if (!generatorSet.isEmpty()) {
-        QFileInfo generatorFile(generatorSet);
+    // The archive is rewritten by every run, so the shards would overwrite each other's files.
+    if (!args.value("output-archive").isEmpty() && (args.contains("shard") || args.contains("merge-shards"))) {
+        std::cerr << qPrintable(appName) << ": --output-archive can't be used with --shard or --merge-shards" << std::endl;
+        return EXIT_FAILURE;
+    }
 
-        if (!generatorFile.exists()) {
-            QString generatorSetName(generatorSet + "_generator" + MODULE_EXTENSION);
-
-            // More library paths may be added via the QT_PLUGIN_PATH environment variable.
-            QCoreApplication::addLibraryPath(GENERATORRUNNER_PLUGIN_DIR);
-            foreach (const QString& path, QCoreApplication::libraryPaths()) {
-                generatorFile.setFile(QDir(path), generatorSetName);
-                if (generatorFile.exists())
-                    break;
-            }
+    if (args.contains("output-cache-stats")) {
+        if (args.value("output-cache").isEmpty()) {
+            std::cerr << qPrintable(appName) << ": --output-cache-stats needs the cache given with --output-cache" << std::endl;
+            return EXIT_FAILURE;
         }
+        OutputCache::Statistics statistics = OutputCache(args.value("output-cache"), 0).statistics();
+        std::cout << "output cache: " << qPrintable(args.value("output-cache")) << std::endl;
+        std::cout << "hits: " << statistics.hits << std::endl;
+        std::cout << "misses: " << statistics.misses << std::endl;
+        std::cout << "evictions: " << statistics.evictions << std::endl;
+        std::cout << "size: " << statistics.size << " bytes" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (args.contains("extract-archive"))
+        return extractArchive(appName, args);
+
+    // Try to load a generator
+    QString pluginFileName;
+    QString generatorSet = generatorSetName(args);
+
+    Profiler::Timer pluginTimer;
+    if (!generatorSet.isEmpty()) {
+        QFileInfo generatorFile = findGeneratorSet(generatorSet);
 
         if (!generatorFile.exists()) {
-            std::cerr << argv[0] << ": Error loading generator-set plugin: ";
+            std::cerr << qPrintable(appName) << ": Error loading generator-set plugin: ";
             std::cerr << qPrintable(generatorFile.baseName()) << " module not found." << std::endl;
             return EXIT_FAILURE;
         }
 
-        QLibrary plugin(generatorFile.filePath());
+        pluginFileName = generatorFile.absoluteFilePath();
+        QLibrary plugin(pluginFileName);
         getGeneratorsFunc getGenerators = (getGeneratorsFunc)plugin.resolve("getGenerators");
         if (getGenerators) {
             getGenerators(&generators);
+            pluginTimer.record("loadPlugin", pluginFileName);
         } else {
-            std::cerr << argv[0] << ": Error loading generator-set plugin: " << qPrintable(plugin.errorString()) << std::endl;
+            std::cerr << qPrintable(appName) << ": Error loading generator-set plugin: " << qPrintable(plugin.errorString()) << std::endl;
             return EXIT_FAILURE;
         }
     } else if (!args.contains("help")) {
-        std::cerr << argv[0] << ": You need to specify a generator with --generator-set=GENERATOR_NAME" << std::endl;
+        std::cerr << qPrintable(appName) << ": You need to specify a generator with --generator-set=GENERATOR_NAME" << std::endl;
         return EXIT_FAILURE;
     }
 
@@ -273,6 +717,16 @@ int main(int argc, char *argv[])
         }
     }
 
+    int jobs = 1;
+    if (args.contains("jobs")) {
+        bool ok = true;
+        jobs = args.value("jobs").isEmpty() ? QThread::idealThreadCount() : args.value("jobs").toInt(&ok);
+        if (!ok || jobs < 1) {
+            std::cerr << "Invalid number of jobs: " << qPrintable(args.value("jobs")) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     QString outputDirectory = args.contains("output-directory") ? args["output-directory"] : "out";
     if (!QDir(outputDirectory).exists()) {
         if (!QDir().mkpath(outputDirectory)) {
@@ -325,24 +779,146 @@ int main(int argc, char *argv[])
         std::cerr << "Too many arguments!" << std::endl;
         return EXIT_FAILURE;
     }
+
+    // ApiExtractor can't store its model, so what is cached is the knowledge
+    // that a previous run with exactly the same inputs already generated everything.
+    QString modelCacheFileName;
+    QByteArray modelInputDigest;
+    QStringList modelInputFiles;
+    if (!args.value("model-cache").isEmpty()) {
+        QDir cacheDir(args.value("model-cache"));
+        if (!cacheDir.exists() && !QDir().mkpath(cacheDir.path())) {
+            ReportHandler::warning("Can't create model cache directory: " + cacheDir.path());
+            return EXIT_FAILURE;
+        }
+        modelCacheFileName = cacheDir.filePath(runConfigurationKey(args, pluginFileName, licenseComment));
+        modelInputFiles = readModelCacheInputFiles(modelCacheFileName);
+        modelInputDigest = runInputDigest(args, pluginFileName, modelInputFiles);
+        if (isModelCacheHit(modelCacheFileName, modelInputDigest)) {
+            qDeleteAll(generators);
+            // Nothing is written, and the depfile of the previous run is still right.
+            if (!changedFilesFileName.isEmpty() && !writeFileList(changedFilesFileName, QStringList()))
+                ReportHandler::warning("Can't write the changed files list: " + changedFilesFileName);
+            std::cout << "Inputs unchanged since the last run, nothing to generate." << std::endl;
+            return EXIT_SUCCESS;
+        }
+    }
+
     extractor.setCppFileName(cppFileName);
     extractor.setTypeSystem(typeSystemFileName);
+    Profiler::Timer extractorTimer;
     if (!extractor.run())
         return EXIT_FAILURE;
+    extractorTimer.record("runApiExtractor", typeSystemFileName);
 
     if (!extractor.classCount())
         ReportHandler::warning("No C++ classes found!");
 
+    QByteArray inputContentsDigest;
+    if (!args.value("output-cache").isEmpty())
+        inputContentsDigest = runContentsDigest(args, pluginFileName);
+
+    bool singlePass = args.contains("single-pass");
+    bool generated = true;
+    GeneratorList readyGenerators;
     foreach (Generator* g, generators) {
         g->setOutputDirectory(outputDirectory);
         g->setLicenseComment(licenseComment);
-        if (g->setup(extractor, args))
-            g->generate();
+        g->setNumberOfJobs(jobs);
+        g->setPluginFileName(pluginFileName);
+        g->setInputContentsDigest(inputContentsDigest);
+        if (!g->setup(extractor, args))
+            continue;
+        if (singlePass)
+            readyGenerators << g;
+        else if (!g->generate())
+            generated = false;
     }
+    if (singlePass && !Generator::generate(readyGenerators))
+        generated = false;
+
+    QSet<QString> inputFiles;
+    QStringList changedFiles;
+    foreach (Generator* g, generators) {
+        inputFiles += g->inputFiles().toSet();
+        changedFiles << g->changedFiles();
+    }
+    QStringList generatorInputFiles = inputFiles.toList();
+    qSort(generatorInputFiles);
+    // The generators share the output archive.
+    changedFiles.removeDuplicates();
     qDeleteAll(generators);
 
+    if (!depFileName.isEmpty()) {
+        inputFiles += runInputFiles(args, pluginFileName);
+        if (!args.value("license-file").isEmpty())
+            inputFiles << QFileInfo(args.value("license-file")).absoluteFilePath();
+        if (!writeDepFile(depFileName, changedFilesFileName, inputFiles))
+            ReportHandler::warning("Can't write the depfile: " + depFileName);
+    }
+    if (!changedFilesFileName.isEmpty() && !writeFileList(changedFilesFileName, changedFiles))
+        ReportHandler::warning("Can't write the changed files list: " + changedFilesFileName);
+
+    // A failed run must not be skipped next time.
+    if (generated && !modelCacheFileName.isEmpty()) {
+        // The digest taken before generating still holds when the generators read the same files.
+        if (generatorInputFiles != modelInputFiles)
+            modelInputDigest = runInputDigest(args, pluginFileName, generatorInputFiles);
+        QStringList runFiles;
+        runFiles << depFileName << changedFilesFileName << profileFileName;
+        if (!writeModelCache(modelCacheFileName, modelInputDigest, generatorInputFiles, outputDirectory, runFiles))
+            ReportHandler::warning("Can't write the model cache key: " + modelCacheFileName);
+    }
+
+    runTimer.record("total");
+    if (!profileFileName.isEmpty() && !Profiler::writeReport(profileFileName))
+        ReportHandler::warning("Can't write the profile report: " + profileFileName);
+
     ReportHandler::flush();
     std::cout << "Done, " << ReportHandler::warningCount();
     std::cout << " warnings (" << ReportHandler::suppressedCount() << " known issues)";
     std::cout << std::endl;
+    return generated ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Returns the value of a command line option, or a null string if it is not given.
+static QString commandLineOption(const QStringList& arguments, const QString& name)
+{
+    foreach (const QString& arg, arguments) {
+        if (arg == "--" + name)
+            return QString("");
+        if (arg.startsWith("--" + name + "="))
+            return arg.mid(name.size() + 3).trimmed();
+    }
+    return QString();
+}
+
+int main(int argc, char *argv[])
+{
+    // needed by qxmlpatterns
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    // The server options are only read from the command line, as a job may not set up a server.
+    QString serverSocket = commandLineOption(arguments, "server");
+    if (!serverSocket.isNull()) {
+        if (serverSocket.isEmpty()) {
+            std::cerr << argv[0] << ": --server needs the name of the socket to listen on" << std::endl;
+            return EXIT_FAILURE;
+        }
+        return runGeneratorServer(serverSocket, preloadGeneratorSet, runGenerators);
+    }
+
+    serverSocket = commandLineOption(arguments, "server-socket");
+    if (!serverSocket.isEmpty()) {
+        foreach (const QString& arg, arguments) {
+            if (arg.startsWith("--server-socket"))
+                arguments.removeOne(arg);
+        }
+        int exitCode;
+        if (forwardToGeneratorServer(serverSocket, arguments, &exitCode))
+            return exitCode;
+    }
+
+    return runGenerators(arguments);
 }
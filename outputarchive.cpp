@@ -0,0 +1,260 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "outputarchive.h"
+#include "outputmanifest.h"
+#include "outputqueue.h"
+#include <reporthandler.h>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSet>
+#include <QtCore/qendian.h>
+#include <climits>
+#include <string.h>
+
+/*
+ *  An archive is made of a header, the contents of the files one after the other, a
+ *  table of fixed size entries sorted by file name and the names, UTF-8 encoded. The
+ *  numbers are little endian and the table is aligned, so it's read in place from the
+ *  mapped file.
+ *
+ *  Header: "GRARCHIV", version (32 bits), number of entries (32 bits), offset of the
+ *  table (64 bits), offset of the names (64 bits). The table offset is 0 while the
+ *  archive is being written.
+ *  Entry: offset and size of the contents (64 bits each), offset in the names and size
+ *  of the name (32 bits each), SHA-1 of the contents (20 bytes), padding (4 bytes).
+ */
+static const char archiveMagic[] = "GRARCHIV";
+static const int magicSize = 8;
+static const quint32 archiveVersion = 1;
+static const int headerSize = 32;
+static const int entrySize = 48;
+static const int digestSize = 20;
+
+static QByteArray archiveHeader(int count, qint64 tableOffset, qint64 namesOffset)
+{
+    QByteArray header(headerSize, '\0');
+    uchar* data = reinterpret_cast<uchar*>(header.data());
+    memcpy(data, archiveMagic, magicSize);
+    qToLittleEndian(archiveVersion, data + 8);
+    qToLittleEndian(quint32(count), data + 12);
+    qToLittleEndian(quint64(tableOffset), data + 16);
+    qToLittleEndian(quint64(namesOffset), data + 24);
+    return header;
+}
+
+OutputArchiveWriter::OutputArchiveWriter(const QString& fileName)
+    : m_file(fileName), m_dataEnd(headerSize), m_committed(false)
+{
+}
+
+bool OutputArchiveWriter::open()
+{
+    QMutexLocker locker(&m_mutex);
+    OutputQueue::makePath(QFileInfo(m_file).absolutePath());
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+    m_dataEnd = headerSize;
+    m_committed = false;
+    m_entries.clear();
+    QByteArray header = archiveHeader(0, 0, 0);
+    return m_file.write(header) == header.size();
+}
+
+bool OutputArchiveWriter::add(const QString& name, const QByteArray& contents)
+{
+    Entry entry;
+    entry.size = contents.size();
+    entry.digest = QCryptographicHash::hash(contents, QCryptographicHash::Sha1);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_committed) {
+        // The new contents overwrite the table, so the archive is incomplete until the next commit().
+        QByteArray header = archiveHeader(0, 0, 0);
+        if (!m_file.seek(0) || m_file.write(header) != header.size())
+            return false;
+        m_committed = false;
+    }
+    entry.offset = m_dataEnd;
+    if (!m_file.seek(m_dataEnd) || m_file.write(contents) != contents.size())
+        return false;
+    m_dataEnd += contents.size();
+    m_entries.insert(name, entry);
+    return true;
+}
+
+bool OutputArchiveWriter::commit()
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 tableOffset = (m_dataEnd + 7) & ~qint64(7);
+    QByteArray table(m_entries.size() * entrySize, '\0');
+    QByteArray names;
+    uchar* data = reinterpret_cast<uchar*>(table.data());
+    for (QMap<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        QByteArray name = it.key().toUtf8();
+        qToLittleEndian(quint64(it.value().offset), data);
+        qToLittleEndian(quint64(it.value().size), data + 8);
+        qToLittleEndian(quint32(names.size()), data + 16);
+        qToLittleEndian(quint32(name.size()), data + 20);
+        memcpy(data + 24, it.value().digest.constData(), digestSize);
+        names += name;
+        data += entrySize;
+    }
+    qint64 namesOffset = tableOffset + table.size();
+    QByteArray padding(int(tableOffset - m_dataEnd), '\0');
+    if (!m_file.seek(m_dataEnd) || m_file.write(padding) != padding.size() || m_file.write(table) != table.size()
+        || m_file.write(names) != names.size() || !m_file.resize(namesOffset + names.size()) || !m_file.flush()) {
+        return false;
+    }
+
+    // The header goes last, so a reader never finds a table that is not complete.
+    QByteArray header = archiveHeader(m_entries.size(), tableOffset, namesOffset);
+    if (!m_file.seek(0) || m_file.write(header) != header.size() || !m_file.flush())
+        return false;
+    m_committed = true;
+    return true;
+}
+
+QString OutputArchiveWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file.errorString();
+}
+
+OutputArchiveReader::OutputArchiveReader()
+    : m_data(0), m_size(0), m_count(0), m_tableOffset(0), m_namesOffset(0), m_namesSize(0)
+{
+}
+
+OutputArchiveReader::~OutputArchiveReader()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+}
+
+bool OutputArchiveReader::open(const QString& fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size >= headerSize)
+        m_data = m_file.map(0, m_size);
+    if (!m_data || memcmp(m_data, archiveMagic, magicSize) != 0
+        || qFromLittleEndian<quint32>(m_data + 8) != archiveVersion) {
+        m_errorString = "not an output archive";
+        return false;
+    }
+    m_tableOffset = qFromLittleEndian<quint64>(m_data + 16);
+    m_namesOffset = qFromLittleEndian<quint64>(m_data + 24);
+    quint32 count = qFromLittleEndian<quint32>(m_data + 12);
+    if (!m_tableOffset) {
+        m_errorString = "the archive was not completely written";
+        return false;
+    }
+    if (m_tableOffset < headerSize || m_tableOffset > m_size || count > quint32((m_size - m_tableOffset) / entrySize)
+        || m_namesOffset != m_tableOffset + qint64(count) * entrySize) {
+        m_errorString = "corrupted archive table";
+        return false;
+    }
+    m_namesSize = m_size - m_namesOffset;
+
+    for (quint32 i = 0; i < count; ++i) {
+        const uchar* data = m_data + m_tableOffset + i * entrySize;
+        quint64 offset = qFromLittleEndian<quint64>(data);
+        quint64 size = qFromLittleEndian<quint64>(data + 8);
+        quint64 nameOffset = qFromLittleEndian<quint32>(data + 16);
+        quint64 nameSize = qFromLittleEndian<quint32>(data + 20);
+        if (offset < quint64(headerSize) || offset > quint64(m_tableOffset) || size > quint64(m_tableOffset) - offset
+            || size > quint64(INT_MAX) || nameOffset + nameSize > quint64(m_namesSize)) {
+            m_errorString = QString("corrupted archive entry %1").arg(i);
+            return false;
+        }
+    }
+    m_count = count;
+    return true;
+}
+
+const uchar* OutputArchiveReader::entry(int index) const
+{
+    return m_data + m_tableOffset + index * entrySize;
+}
+
+QString OutputArchiveReader::name(int index) const
+{
+    const uchar* data = entry(index);
+    const char* names = reinterpret_cast<const char*>(m_data + m_namesOffset);
+    return QString::fromUtf8(names + qFromLittleEndian<quint32>(data + 16), qFromLittleEndian<quint32>(data + 20));
+}
+
+QByteArray OutputArchiveReader::contents(int index) const
+{
+    const uchar* data = entry(index);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + qFromLittleEndian<quint64>(data)),
+                                   int(qFromLittleEndian<quint64>(data + 8)));
+}
+
+QByteArray OutputArchiveReader::digest(int index) const
+{
+    return QByteArray(reinterpret_cast<const char*>(entry(index) + 24), digestSize).toHex();
+}
+
+bool OutputArchiveReader::extract(const QString& directory, int jobs, QStringList* writtenFiles)
+{
+    QStringList names;
+    QSet<QString> filePaths;
+    for (int i = 0; i < m_count; ++i) {
+        QString name = QDir::cleanPath(this->name(i));
+        if (name.isEmpty() || QDir::isAbsolutePath(name) || name == ".." || name.startsWith("../")) {
+            m_errorString = QString("the file '%1' is out of the extraction directory").arg(this->name(i));
+            return false;
+        }
+        names << name;
+        filePaths.insert(directory + '/' + name);
+    }
+
+    // Each archive has its own manifest, the generators keep theirs in the same directory.
+    QString manifestFileName = QString("%1/.%2.outputs").arg(directory).arg(QFileInfo(m_file).fileName());
+    OutputManifest manifest;
+    manifest.load(manifestFileName);
+
+    QAtomicInt written = 0;
+    OutputQueue queue(qMax(jobs, 1), 64 * 1024 * 1024);
+    for (int i = 0; i < m_count; ++i)
+        queue.enqueue(directory + '/' + names[i], contents(i), &written, &manifest, digest(i));
+    queue.waitForDone();
+    *writtenFiles = queue.takeWrittenFiles();
+
+    // The files extracted by the previous run that the archive doesn't have anymore.
+    foreach (const QString& filePath, manifest.unusedFiles()) {
+        if (!filePaths.contains(filePath) && QFile::remove(filePath))
+            ReportHandler::debugSparse(QString("removed: %1").arg(filePath));
+    }
+
+    if (!manifest.save(manifestFileName))
+        ReportHandler::warning(QString("unable to write the output manifest '%1'").arg(manifestFileName));
+    return true;
+}
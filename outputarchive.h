@@ -0,0 +1,119 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef OUTPUTARCHIVE_H
+#define OUTPUTARCHIVE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+#include "generatorrunnermacros.h"
+
+/**
+ *   Writes the generated files into an archive. The contents are written as soon as
+ *   they are added, only the table is kept in memory and written by commit(), which
+ *   can be called again after adding more files. A file added twice keeps the
+ *   contents added last.
+ *   add() and commit() are thread safe.
+ */
+class GENRUNNER_API OutputArchiveWriter
+{
+public:
+    explicit OutputArchiveWriter(const QString& fileName);
+
+    /// Creates the archive, replacing an existing one. Returns false on failure.
+    bool open();
+
+    /// Adds a file to the archive with \p name, a path relative to the extraction directory.
+    bool add(const QString& name, const QByteArray& contents);
+
+    /// Writes the table, making the archive readable. Returns false on failure.
+    bool commit();
+
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const;
+
+private:
+    struct Entry
+    {
+        qint64 offset;
+        qint64 size;
+        QByteArray digest;
+    };
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    qint64 m_dataEnd;
+    bool m_committed;
+    QMap<QString, Entry> m_entries;
+};
+
+/**
+ *   Reads an archive written by OutputArchiveWriter. The file is mapped in memory and
+ *   the contents returned point into the mapping, so they are valid while the reader
+ *   exists.
+ */
+class GENRUNNER_API OutputArchiveReader
+{
+public:
+    OutputArchiveReader();
+    ~OutputArchiveReader();
+
+    /// Maps the archive and checks its table. Returns false if it's not a complete archive.
+    bool open(const QString& fileName);
+
+    int count() const { return m_count; }
+    QString name(int index) const;
+    QByteArray contents(int index) const;
+
+    /// Returns the SHA-1 of the contents stored in the archive, hex encoded like OutputManifest::digest().
+    QByteArray digest(int index) const;
+
+    /**
+     *   Writes the files of the archive into \p directory using \p jobs threads, except
+     *   the ones already there with the same contents. The written files are returned
+     *   in \p writtenFiles. A manifest of the extracted files is kept in the directory,
+     *   so the unchanged files are usually not read back, and the files extracted before
+     *   that are not in the archive anymore are removed.
+     *   Returns false if the archive has a name going out of the directory.
+     */
+    bool extract(const QString& directory, int jobs, QStringList* writtenFiles);
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    const uchar* entry(int index) const;
+
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    int m_count;
+    qint64 m_tableOffset;
+    qint64 m_namesOffset;
+    qint64 m_namesSize;
+    QString m_errorString;
+};
+
+#endif // OUTPUTARCHIVE_H
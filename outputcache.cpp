@@ -0,0 +1,193 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "outputcache.h"
+#include "outputqueue.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QThread>
+#include <QtAlgorithms>
+#ifdef Q_OS_WIN
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+// Cleaning up leaves room for some runs before the next one.
+static const int evictionTargetPercent = 90;
+
+/// Marks a cached file as used now, which is what the eviction looks at.
+static void touch(const QString& fileName)
+{
+#ifdef Q_OS_WIN
+    _wutime(reinterpret_cast<const wchar_t*>(fileName.utf16()), 0);
+#else
+    utime(QFile::encodeName(fileName).constData(), 0);
+#endif
+}
+
+OutputCache::OutputCache(const QString& directory, qint64 maxSize)
+    : m_directory(directory), m_maxSize(maxSize)
+{
+    m_pending.hits = 0;
+    m_pending.misses = 0;
+    m_pending.evictions = 0;
+    m_pending.size = 0;
+}
+
+QString OutputCache::filePath(const QByteArray& key) const
+{
+    return QString("%1/%2/%3").arg(m_directory).arg(QString(key.left(2))).arg(QString(key.mid(2)));
+}
+
+bool OutputCache::fetch(const QByteArray& key, QByteArray* contents)
+{
+    QString fileName = filePath(key);
+    QFile file(fileName);
+    bool found = file.open(QIODevice::ReadOnly);
+    if (found) {
+        *contents = file.readAll();
+        file.close();
+        touch(fileName);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (found)
+        ++m_pending.hits;
+    else
+        ++m_pending.misses;
+    return found;
+}
+
+void OutputCache::store(const QByteArray& key, const QByteArray& contents)
+{
+    QString fileName = filePath(key);
+    if (!OutputQueue::makePath(QFileInfo(fileName).absolutePath()))
+        return;
+
+    // Written aside and renamed, so other runs never read a partial file.
+    QFile file(QString("%1.tmp-%2-%3").arg(fileName).arg(QCoreApplication::applicationPid())
+               .arg(quintptr(QThread::currentThreadId())));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    bool written = file.write(contents) == contents.size();
+    file.close();
+    if (!written || !file.rename(fileName)) {
+        file.remove();
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pending.size += contents.size();
+}
+
+OutputCache::Statistics OutputCache::readStatistics() const
+{
+    Statistics statistics = { 0, 0, 0, 0 };
+    QFile file(m_directory + "/stats");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return statistics;
+    while (!file.atEnd()) {
+        QList<QByteArray> fields = file.readLine().trimmed().split(' ');
+        if (fields.size() != 2)
+            continue;
+        qint64 value = fields.last().toLongLong();
+        if (fields.first() == "hits")
+            statistics.hits = value;
+        else if (fields.first() == "misses")
+            statistics.misses = value;
+        else if (fields.first() == "evictions")
+            statistics.evictions = value;
+        else if (fields.first() == "size")
+            statistics.size = value;
+    }
+    return statistics;
+}
+
+void OutputCache::writeStatistics(const Statistics& statistics) const
+{
+    QFile file(m_directory + "/stats");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return;
+    file.write("hits " + QByteArray::number(statistics.hits) + '\n');
+    file.write("misses " + QByteArray::number(statistics.misses) + '\n');
+    file.write("evictions " + QByteArray::number(statistics.evictions) + '\n');
+    file.write("size " + QByteArray::number(statistics.size) + '\n');
+}
+
+void OutputCache::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!OutputQueue::makePath(m_directory))
+        return;
+    Statistics statistics = readStatistics();
+    statistics.hits += m_pending.hits;
+    statistics.misses += m_pending.misses;
+    statistics.size += m_pending.size;
+    m_pending.hits = 0;
+    m_pending.misses = 0;
+    m_pending.size = 0;
+
+    // The size is only counted, so the files are looked at only when it is over the limit.
+    if (statistics.size > m_maxSize) {
+        qint64 totalSize = 0;
+        QList<QPair<uint, QString> > files;
+        QHash<QString, qint64> sizes;
+        QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            QFileInfo info = it.fileInfo();
+            if (info.fileName() == "stats" || info.fileName().contains(".tmp-"))
+                continue;
+            files << qMakePair(info.lastModified().toTime_t(), info.filePath());
+            sizes.insert(info.filePath(), info.size());
+            totalSize += info.size();
+        }
+        qSort(files);
+
+        qint64 targetSize = m_maxSize / 100 * evictionTargetPercent;
+        for (int i = 0; i < files.size() && totalSize > targetSize; ++i) {
+            if (QFile::remove(files[i].second)) {
+                totalSize -= sizes.value(files[i].second);
+                ++statistics.evictions;
+            }
+        }
+        statistics.size = totalSize;
+    }
+    writeStatistics(statistics);
+}
+
+OutputCache::Statistics OutputCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = readStatistics();
+    statistics.hits += m_pending.hits;
+    statistics.misses += m_pending.misses;
+    statistics.size += m_pending.size;
+    return statistics;
+}
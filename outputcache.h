@@ -0,0 +1,78 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef OUTPUTCACHE_H
+#define OUTPUTCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include "generatorrunnermacros.h"
+
+/**
+ *   Directory of generated files addressed by a key of everything used to generate
+ *   them, shared by all the runs on a machine, like the ones of different build trees.
+ *   The least recently used files are removed when the cache grows over its size limit.
+ *   The statistics are kept in the cache directory and updated by flush(); runs sharing
+ *   the cache at the same time may lose some of the counts of each other.
+ *   All methods are thread safe.
+ */
+class GENRUNNER_API OutputCache
+{
+public:
+    struct Statistics
+    {
+        qint64 hits;
+        qint64 misses;
+        qint64 evictions;
+        qint64 size;
+    };
+
+    OutputCache(const QString& directory, qint64 maxSize);
+
+    /// Reads the file cached with \p key into \p contents, returning false if there is none.
+    bool fetch(const QByteArray& key, QByteArray* contents);
+
+    /// Adds \p contents to the cache with \p key.
+    void store(const QByteArray& key, const QByteArray& contents);
+
+    /// Saves the counts of this run in the statistics, removing old files if the cache is too big.
+    void flush();
+
+    /// Returns the statistics of the cache, the counts not flushed yet included.
+    Statistics statistics() const;
+
+    QString directory() const { return m_directory; }
+
+private:
+    QString filePath(const QByteArray& key) const;
+    Statistics readStatistics() const;
+    void writeStatistics(const Statistics& statistics) const;
+
+    QString m_directory;
+    qint64 m_maxSize;
+    mutable QMutex m_mutex;
+    Statistics m_pending;
+};
+
+#endif // OUTPUTCACHE_H
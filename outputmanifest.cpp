@@ -0,0 +1,130 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "outputmanifest.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStringList>
+
+bool OutputManifest::load(const QString& fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    // The entries were recorded at the latest when the manifest was saved.
+    uint saved = QFileInfo(file).lastModified().toTime_t();
+
+    while (!file.atEnd()) {
+        // digest size modified path
+        QString line = QString::fromUtf8(file.readLine());
+        if (line.endsWith('\n'))
+            line.chop(1);
+        QStringList fields = line.split(' ');
+        if (fields.size() < 4)
+            continue;
+        Entry entry;
+        entry.digest = fields[0].toAscii();
+        entry.size = fields[1].toLongLong();
+        entry.modified = fields[2].toUInt();
+        entry.recorded = saved;
+        entry.used = false;
+        m_entries.insert(QStringList(fields.mid(3)).join(" "), entry);
+    }
+    return true;
+}
+
+bool OutputManifest::save(const QString& fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    QStringList paths = m_entries.keys();
+    qSort(paths);
+    foreach (const QString& path, paths) {
+        const Entry& entry = m_entries[path];
+        if (!entry.used || !QFile::exists(path))
+            continue;
+        file.write(QString("%1 %2 %3 %4\n").arg(QString(entry.digest)).arg(entry.size)
+                   .arg(entry.modified).arg(path).toUtf8());
+    }
+    return true;
+}
+
+OutputManifest::State OutputManifest::check(const QFileInfo& file, const QByteArray& digest)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Entry>::iterator it = m_entries.find(file.filePath());
+    if (it == m_entries.end() || !file.exists())
+        return Unknown;
+    it->used = true;
+    if (file.size() != it->size || file.lastModified().toTime_t() != it->modified || it->modified >= it->recorded)
+        return Unknown;
+    return it->digest == digest ? Unchanged : Changed;
+}
+
+void OutputManifest::update(const QString& fileName, const QByteArray& digest)
+{
+    QFileInfo info(fileName);
+    Entry entry;
+    entry.size = info.size();
+    entry.modified = info.lastModified().toTime_t();
+    entry.recorded = QDateTime::currentDateTime().toTime_t();
+    entry.digest = digest;
+    entry.used = true;
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(fileName, entry);
+}
+
+bool OutputManifest::keep(const QFileInfo& file)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Entry>::iterator it = m_entries.find(file.filePath());
+    if (it == m_entries.end() || !file.exists())
+        return false;
+    it->used = true;
+    return file.size() == it->size && file.lastModified().toTime_t() == it->modified && it->modified < it->recorded;
+}
+
+QStringList OutputManifest::unusedFiles() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList files;
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (!it->used)
+            files << it.key();
+    }
+    qSort(files);
+    return files;
+}
+
+QByteArray OutputManifest::digest(const QByteArray& contents)
+{
+    return QCryptographicHash::hash(contents, QCryptographicHash::Sha1).toHex();
+}
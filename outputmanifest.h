@@ -0,0 +1,101 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef OUTPUTMANIFEST_H
+#define OUTPUTMANIFEST_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class QFileInfo;
+
+/**
+ *   Records the size, modification time and digest of the files written by a
+ *   generator, so that a later run can tell whether new contents are the ones
+ *   already on disk without reading the file back. The size and modification
+ *   time detect files changed by someone else since they were recorded, except
+ *   in the second they were recorded, when the contents must be compared.
+ *   Only the files used since the manifest was loaded are saved back, so the
+ *   files not generated anymore drop out of it. All methods are thread safe.
+ */
+class OutputManifest
+{
+public:
+    enum State {
+        Unknown,
+        Unchanged,
+        Changed
+    };
+
+    /// Loads the manifest, returning false if the file couldn't be read.
+    bool load(const QString& fileName);
+
+    /**
+     *   Saves the entries checked, updated or kept since the manifest was loaded whose
+     *   files still exist, returning false if the file couldn't be written.
+     */
+    bool save(const QString& fileName) const;
+
+    /**
+     *   Tells if a file with the given \p digest has the same contents of \p file.
+     *   Returns Unknown if the file was not recorded or was changed since then.
+     */
+    State check(const QFileInfo& file, const QByteArray& digest);
+
+    /// Records the current size and modification time of \p fileName together with its \p digest.
+    void update(const QString& fileName, const QByteArray& digest);
+
+    /**
+     *   Tells if \p file still has the size and modification time recorded, so it is the
+     *   file written then, keeping its entry. A file recorded in the second it was last
+     *   modified is not known to be unchanged. For a file still generated but not checked
+     *   by this run.
+     */
+    bool keep(const QFileInfo& file);
+
+    /// Returns the files recorded when the manifest was loaded that were not used since then.
+    QStringList unusedFiles() const;
+
+    /// Returns the digest used by the manifest for the given contents.
+    static QByteArray digest(const QByteArray& contents);
+
+private:
+    struct Entry
+    {
+        qint64 size;
+        uint modified;
+        // When the entry was recorded. A file modified in that second may have been
+        // changed again in the same second, keeping its size and modification time.
+        uint recorded;
+        QByteArray digest;
+        bool used;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // OUTPUTMANIFEST_H
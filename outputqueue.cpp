@@ -0,0 +1,251 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "outputqueue.h"
+#include "outputmanifest.h"
+#include "profiler.h"
+#include <reporthandler.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+static QMutex knownDirectoriesMutex;
+static QSet<QString> knownDirectories;
+
+class OutputQueue::WriterThread : public QThread
+{
+public:
+    WriterThread(OutputQueue* queue) : m_queue(queue) {}
+
+protected:
+    void run()
+    {
+        m_queue->processItems();
+    }
+
+private:
+    OutputQueue* m_queue;
+};
+
+OutputQueue::OutputQueue(int numberOfThreads, qint64 maxPendingBytes)
+    : m_maxPendingBytes(maxPendingBytes), m_pendingBytes(0), m_itemsInProgress(0), m_stopping(false)
+{
+    for (int i = 0; i < qMax(numberOfThreads, 1); ++i) {
+        QThread* thread = new WriterThread(this);
+        thread->start();
+        m_threads << thread;
+    }
+}
+
+OutputQueue::~OutputQueue()
+{
+    waitForDone();
+
+    m_mutex.lock();
+    m_stopping = true;
+    m_itemQueued.wakeAll();
+    m_mutex.unlock();
+
+    foreach (QThread* thread, m_threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void OutputQueue::enqueue(const QString& fileName, const QByteArray& contents, QAtomicInt* writtenCounter,
+                          OutputManifest* manifest, const QByteArray& digest)
+{
+    QMutexLocker locker(&m_mutex);
+    // A file bigger than the limit is accepted when nothing else is pending.
+    while (m_pendingBytes > 0 && m_pendingBytes + contents.size() > m_maxPendingBytes)
+        m_itemDone.wait(&m_mutex);
+
+    Item item;
+    item.fileName = fileName;
+    item.contents = contents;
+    item.writtenCounter = writtenCounter;
+    item.manifest = manifest;
+    item.digest = digest;
+    m_items.enqueue(item);
+    m_pendingBytes += contents.size();
+    m_itemQueued.wakeOne();
+}
+
+void OutputQueue::waitForDone()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_items.isEmpty() || m_itemsInProgress > 0)
+        m_itemDone.wait(&m_mutex);
+    QStringList errors = m_errors;
+    m_errors.clear();
+    locker.unlock();
+
+    foreach (const QString& error, errors)
+        ReportHandler::warning(error);
+}
+
+QStringList OutputQueue::takeWrittenFiles()
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList writtenFiles = m_writtenFiles;
+    m_writtenFiles.clear();
+    return writtenFiles;
+}
+
+void OutputQueue::processItems()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        while (m_items.isEmpty() && !m_stopping)
+            m_itemQueued.wait(&m_mutex);
+        if (m_items.isEmpty())
+            return;
+
+        Item item = m_items.dequeue();
+        ++m_itemsInProgress;
+        locker.unlock();
+
+        QString errorMessage;
+        bool written = writeFile(item.fileName, item.contents, &errorMessage, item.manifest, item.digest);
+        if (written)
+            item.writtenCounter->ref();
+
+        locker.relock();
+        if (written)
+            m_writtenFiles << item.fileName;
+        --m_itemsInProgress;
+        m_pendingBytes -= item.contents.size();
+        if (!errorMessage.isEmpty())
+            m_errors << errorMessage;
+        m_itemDone.wakeAll();
+    }
+}
+
+static bool doWriteFile(const QString& fileName, const QByteArray& contents, QString* errorMessage,
+                        OutputManifest* manifest, QByteArray digest)
+{
+    QFile file(fileName);
+    QFileInfo info(file);
+    OutputManifest::State state = OutputManifest::Unknown;
+    if (manifest) {
+        if (digest.isEmpty())
+            digest = OutputManifest::digest(contents);
+        state = manifest->check(info, digest);
+        if (state == OutputManifest::Unchanged)
+            return false;
+    }
+
+    if (state == OutputManifest::Unknown && info.exists() && info.size() == contents.size()) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            *errorMessage = QString("failed to open file '%1' for reading").arg(fileName);
+            return false;
+        }
+        bool fileEqual = file.readAll() == contents;
+        file.close();
+        if (fileEqual) {
+            if (manifest)
+                manifest->update(fileName, digest);
+            return false;
+        }
+    }
+
+    if (!OutputQueue::makePath(info.absolutePath())) {
+        *errorMessage = QString("unable to create directory '%1'").arg(info.absolutePath());
+        return false;
+    }
+
+    // The directory may have been removed since makePath() found it.
+    if (!file.open(QIODevice::WriteOnly)
+        && (!OutputQueue::makePath(info.absolutePath(), true) || !file.open(QIODevice::WriteOnly))) {
+        *errorMessage = QString("failed to write file '%1'").arg(fileName);
+        return false;
+    }
+    if (file.write(contents) != contents.size()) {
+        *errorMessage = QString("failed to write file '%1'").arg(fileName);
+        return false;
+    }
+    file.close();
+    if (manifest)
+        manifest->update(fileName, digest);
+    return true;
+}
+
+bool OutputQueue::writeFile(const QString& fileName, const QByteArray& contents, QString* errorMessage,
+                            OutputManifest* manifest, const QByteArray& digest)
+{
+    Profiler::Timer timer;
+    bool written = doWriteFile(fileName, contents, errorMessage, manifest, digest);
+    timer.record(written ? "writeFile" : "compareFile", fileName, contents.size());
+    return written;
+}
+
+bool OutputQueue::makePath(const QString& path, bool checkAgain)
+{
+    if (!checkAgain) {
+        QMutexLocker locker(&knownDirectoriesMutex);
+        if (knownDirectories.contains(path))
+            return true;
+    }
+    // When another thread creates a parent meanwhile mkpath() fails, so it is tried again.
+    QDir dir;
+    if (!dir.mkpath(path) && !dir.mkpath(path))
+        return false;
+    QMutexLocker locker(&knownDirectoriesMutex);
+    knownDirectories.insert(path);
+    return true;
+}
+
+class CreateDirectoryTask : public QRunnable
+{
+public:
+    CreateDirectoryTask(const QString& path, bool* created) : m_path(path), m_created(created) {}
+
+    void run()
+    {
+        *m_created = OutputQueue::makePath(m_path);
+    }
+
+private:
+    QString m_path;
+    bool* m_created;
+};
+
+void OutputQueue::createDirectories(const QStringList& directories, int jobs)
+{
+    QVector<bool> created(directories.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(jobs, 1));
+    for (int i = 0; i < directories.size(); ++i)
+        pool.start(new CreateDirectoryTask(directories[i], &created[i]));
+    pool.waitForDone();
+
+    for (int i = 0; i < directories.size(); ++i) {
+        if (!created[i])
+            ReportHandler::warning(QString("unable to create directory '%1'").arg(directories[i]));
+    }
+}
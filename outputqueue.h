@@ -0,0 +1,115 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef OUTPUTQUEUE_H
+#define OUTPUTQUEUE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include <QtCore/QWaitCondition>
+
+class OutputManifest;
+class QThread;
+
+/**
+ *   Writes generated files on background threads. Each file is compared with
+ *   the existing one and only written if it changed. The memory held by the
+ *   pending files is limited: enqueue() blocks until the writer threads catch up.
+ */
+class OutputQueue
+{
+public:
+    OutputQueue(int numberOfThreads, qint64 maxPendingBytes);
+    ~OutputQueue();
+
+    /**
+     *   Queues a file to be written, incrementing \p writtenCounter if the file
+     *   contents changed. Blocks while the pending files exceed the memory limit.
+     *   \see writeFile
+     */
+    void enqueue(const QString& fileName, const QByteArray& contents, QAtomicInt* writtenCounter,
+                 OutputManifest* manifest = 0, const QByteArray& digest = QByteArray());
+
+    /// Waits until all queued files are written, reporting the errors found meanwhile.
+    void waitForDone();
+
+    /// Returns the files written since the last call, the unchanged ones excluded.
+    QStringList takeWrittenFiles();
+
+    /**
+     *   Writes \p contents to \p fileName, creating its directory if needed, unless
+     *   the file already has the same contents. Returns true if the file was written.
+     *   On failure returns false and sets \p errorMessage.
+     *   When a \p manifest is given, it is used to tell if the contents changed
+     *   without reading the existing file, and it is updated with the file. The
+     *   OutputManifest::digest() of the contents is computed unless given in \p digest.
+     */
+    static bool writeFile(const QString& fileName, const QByteArray& contents, QString* errorMessage,
+                          OutputManifest* manifest = 0, const QByteArray& digest = QByteArray());
+
+    /**
+     *   Creates \p path and its parents unless it was already created or found by this
+     *   process, so the files written in the same directory check it only once.
+     *   With \p checkAgain the directory is checked even if it was known, for when
+     *   it was removed meanwhile. Returns false if the directory can't be created.
+     */
+    static bool makePath(const QString& path, bool checkAgain = false);
+
+    /**
+     *   Creates \p directories using up to \p jobs threads, reporting the ones that
+     *   can't be created. They are remembered by makePath().
+     */
+    static void createDirectories(const QStringList& directories, int jobs);
+
+private:
+    struct Item
+    {
+        QString fileName;
+        QByteArray contents;
+        QAtomicInt* writtenCounter;
+        OutputManifest* manifest;
+        QByteArray digest;
+    };
+
+    class WriterThread;
+    friend class WriterThread;
+    void processItems();
+
+    QMutex m_mutex;
+    QWaitCondition m_itemQueued;
+    QWaitCondition m_itemDone;
+    QQueue<Item> m_items;
+    qint64 m_maxPendingBytes;
+    qint64 m_pendingBytes;
+    int m_itemsInProgress;
+    bool m_stopping;
+    QStringList m_errors;
+    QStringList m_writtenFiles;
+    QList<QThread*> m_threads;
+};
+
+#endif // OUTPUTQUEUE_H
@@ -0,0 +1,198 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "profiler.h"
+#include "generatorrunnerconfig.h"
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QTextStream>
+#include <QtCore/QTime>
+#include <ctime>
+#ifndef _WIN32
+    #include <time.h>
+    #include <sys/resource.h>
+#endif
+
+namespace
+{
+
+struct Entry
+{
+    QString phase;
+    QString name;
+    qint64 size;
+    qint64 start;
+    qint64 wall;
+    qint64 cpu;
+};
+
+struct Total
+{
+    Total() : count(0), wall(0), cpu(0), size(0) {}
+    int count;
+    qint64 wall;
+    qint64 cpu;
+    qint64 size;
+};
+
+}
+
+static bool profilerEnabled = false;
+static QMutex profilerMutex;
+static QList<Entry> profilerEntries;
+
+// Times are in microseconds. Where available the CPU time is the one of the
+// calling thread, so timings recorded by worker threads don't include each other.
+static qint64 wallTime()
+{
+#ifdef _WIN32
+    static QTime start = QTime::currentTime();
+    return qint64(start.msecsTo(QTime::currentTime())) * 1000;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static qint64 cpuTime()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+    return qint64(std::clock()) * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+// Peak resident memory of the process in bytes, or -1 if unknown.
+static qint64 peakMemory()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static QString jsonString(const QString& value)
+{
+    QString result("\"");
+    foreach (QChar c, value) {
+        if (c == '"' || c == '\\')
+            result += QString("\\") + c;
+        else if (c.unicode() < 0x20)
+            result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            result += c;
+    }
+    return result + '"';
+}
+
+static const qint64 processStart = wallTime();
+
+Profiler::Timer::Timer() : m_wallStart(wallTime()), m_cpuStart(cpuTime())
+{
+}
+
+void Profiler::Timer::record(const QString& phase, const QString& name, qint64 size) const
+{
+    if (!profilerEnabled)
+        return;
+    Entry entry;
+    entry.phase = phase;
+    entry.name = name;
+    entry.size = size;
+    entry.start = m_wallStart - processStart;
+    entry.wall = wallTime() - m_wallStart;
+    entry.cpu = cpuTime() - m_cpuStart;
+
+    QMutexLocker locker(&profilerMutex);
+    profilerEntries << entry;
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    profilerEnabled = enabled;
+}
+
+bool Profiler::isEnabled()
+{
+    return profilerEnabled;
+}
+
+bool Profiler::writeReport(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QMutexLocker locker(&profilerMutex);
+    QMap<QString, Total> totals;
+    QTextStream s(&file);
+    s.setCodec("UTF-8");
+    s << "{" << endl;
+    s << "  \"version\": " << jsonString(GENERATORRUNNER_VERSION) << ',' << endl;
+    s << "  \"timeUnit\": \"us\"," << endl;
+    if (peakMemory() >= 0)
+        s << "  \"peakMemory\": " << peakMemory() << ',' << endl;
+    s << "  \"entries\": [";
+    for (int i = 0; i < profilerEntries.size(); ++i) {
+        const Entry& entry = profilerEntries[i];
+        s << (i ? "," : "") << endl;
+        s << "    { \"phase\": " << jsonString(entry.phase);
+        if (!entry.name.isEmpty())
+            s << ", \"name\": " << jsonString(entry.name);
+        if (entry.size >= 0)
+            s << ", \"size\": " << entry.size;
+        s << ", \"start\": " << entry.start << ", \"wall\": " << entry.wall << ", \"cpu\": " << entry.cpu << " }";
+
+        Total& total = totals[entry.phase];
+        ++total.count;
+        total.wall += entry.wall;
+        total.cpu += entry.cpu;
+        if (entry.size > 0)
+            total.size += entry.size;
+    }
+    s << endl << "  ]," << endl;
+    s << "  \"totals\": {";
+    QMap<QString, Total>::const_iterator it = totals.constBegin();
+    for (; it != totals.constEnd(); ++it) {
+        s << (it == totals.constBegin() ? "" : ",") << endl;
+        s << "    " << jsonString(it.key()) << ": { \"count\": " << it->count << ", \"wall\": " << it->wall
+          << ", \"cpu\": " << it->cpu << ", \"size\": " << it->size << " }";
+    }
+    s << endl << "  }" << endl;
+    s << "}" << endl;
+    return s.status() == QTextStream::Ok;
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QtCore/QString>
+#include "generatorrunnermacros.h"
+
+/**
+ *   Collects the wall and CPU time spent in each phase of a run, to be saved as
+ *   JSON with the --profile option. Timings are only kept while the profiler is
+ *   enabled, and can be recorded from any thread.
+ */
+class GENRUNNER_API Profiler
+{
+public:
+    /// Measures the time elapsed since its creation.
+    class GENRUNNER_API Timer
+    {
+    public:
+        Timer();
+
+        /**
+         *   Records the time elapsed since the timer creation for \p phase. The
+         *   \p name tells what was processed, like a class or a file, and \p size
+         *   the amount of output produced, if any.
+         */
+        void record(const QString& phase, const QString& name = QString(), qint64 size = -1) const;
+
+    private:
+        qint64 m_wallStart;
+        qint64 m_cpuStart;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    /// Writes the timings recorded so far as JSON, returning false if the file couldn't be written.
+    static bool writeReport(const QString& fileName);
+};
+
+#endif // PROFILER_H
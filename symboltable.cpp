@@ -0,0 +1,92 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "symboltable.h"
+
+uint qHash(const SymbolTable::NameKey& key)
+{
+    return uint(key.kind) ^ qHash(key.object) ^ qHash(key.signature);
+}
+
+SymbolTable* SymbolTable::instance()
+{
+    static SymbolTable table;
+    return &table;
+}
+
+int SymbolTable::symbol(const QString& name)
+{
+    {
+        QReadLocker locker(&m_lock);
+        QHash<QString, int>::const_iterator it = m_symbols.constFind(name);
+        if (it != m_symbols.constEnd())
+            return it.value();
+    }
+    QWriteLocker locker(&m_lock);
+    return symbolLocked(name);
+}
+
+int SymbolTable::symbolLocked(const QString& name)
+{
+    QHash<QString, int>::const_iterator it = m_symbols.constFind(name);
+    if (it != m_symbols.constEnd())
+        return it.value();
+    int symbol = m_names.size();
+    m_names.append(name);
+    m_symbols.insert(name, symbol);
+    return symbol;
+}
+
+QString SymbolTable::name(int symbol) const
+{
+    QReadLocker locker(&m_lock);
+    return m_names.value(symbol);
+}
+
+int SymbolTable::findName(NameKind kind, const void* object, const QString& signature) const
+{
+    NameKey key = { kind, object, signature };
+    QReadLocker locker(&m_lock);
+    return m_objectNames.value(key, -1);
+}
+
+int SymbolTable::addName(NameKind kind, const void* object, const QString& signature, const QString& name)
+{
+    NameKey key = { kind, object, signature };
+    QWriteLocker locker(&m_lock);
+    // Another thread may have added it meanwhile; the first name stays.
+    QHash<NameKey, int>::const_iterator it = m_objectNames.constFind(key);
+    if (it != m_objectNames.constEnd())
+        return it.value();
+    int symbol = symbolLocked(name);
+    m_objectNames.insert(key, symbol);
+    return symbol;
+}
+
+void SymbolTable::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_symbols.clear();
+    m_names.clear();
+    m_objectNames.clear();
+}
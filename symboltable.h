@@ -0,0 +1,99 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include "generatorrunnermacros.h"
+
+/**
+ *   Interns the names the generators ask for again and again: qualified names of
+ *   classes, enums and types. Each name is kept once and given a symbol, a small
+ *   integer, so equal names have equal symbols and share the same string data.
+ *
+ *   The names computed for a model object are remembered by object, so they are
+ *   built only once in a run. Names of types are remembered by type entry and
+ *   signature, since generators may build temporary AbstractMetaTypes.
+ *   The table is shared by all the generators and threads of a run. Since it is
+ *   keyed by the model objects, it is cleared when a generator is set up with
+ *   another ApiExtractor and when the last generator is destroyed.
+ */
+class GENRUNNER_API SymbolTable
+{
+public:
+    /// The kinds of names remembered by object.
+    enum NameKind {
+        TargetName,
+        TargetFullName,
+        FullTypeName,
+        FullTypeNameWithoutModifiers,
+        SimplifiedContainerTypeName
+    };
+
+    static SymbolTable* instance();
+
+    /// Returns the symbol of \p name, adding the name to the table if needed.
+    int symbol(const QString& name);
+    /// Returns the name of a \p symbol, sharing the data kept by the table.
+    QString name(int symbol) const;
+    /// Returns the copy of \p name kept by the table.
+    QString intern(const QString& name) { return this->name(symbol(name)); }
+
+    /**
+     *   Returns the symbol of the name of kind \p kind added for \p object and
+     *   \p signature by addName(), or -1 if it wasn't added yet.
+     */
+    int findName(NameKind kind, const void* object, const QString& signature = QString()) const;
+    /// Remembers \p name as the name of kind \p kind of \p object, returning its symbol.
+    int addName(NameKind kind, const void* object, const QString& signature, const QString& name);
+
+    /// Forgets all the names and symbols.
+    void clear();
+
+private:
+    struct NameKey
+    {
+        NameKind kind;
+        const void* object;
+        QString signature;
+
+        bool operator==(const NameKey& other) const
+        {
+            return kind == other.kind && object == other.object && signature == other.signature;
+        }
+    };
+    friend uint qHash(const NameKey& key);
+
+    int symbolLocked(const QString& name);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, int> m_symbols;
+    QVector<QString> m_names;
+    QHash<NameKey, int> m_objectNames;
+};
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,356 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Generates synthetic headers, type systems and documentation of growing sizes,
+ * runs generatorrunner with --profile on each of them and writes the throughput,
+ * peak memory and time per phase of every run as JSON, so that runs of different
+ * commits can be compared and super-linear scaling spotted.
+ *
+ * Options not known by the benchmark are passed to generatorrunner, e.g. --jobs=4.
+ */
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMap>
+#include <QtCore/QProcess>
+#include <QtCore/QRegExp>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QTime>
+#include <iostream>
+#include "genbenchmarkconfig.h"
+
+struct ModelShape
+{
+    int classes;
+    int methods;
+    int enums;
+    int containers;
+    int inheritanceDepth;
+};
+
+struct RunResult
+{
+    QString generator;
+    int classes;
+    bool ok;
+    qint64 wall;
+    qint64 peakMemory;
+    QMap<QString, QList<qint64> > phases; // count, wall, cpu, size
+};
+
+static QString className(int i)
+{
+    return QString("Class%1").arg(i);
+}
+
+static void writeHeader(const QString& fileName, const ModelShape& shape)
+{
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream s(&file);
+    s << "#ifndef BENCHMARK_H" << endl << "#define BENCHMARK_H" << endl << endl;
+    s << "template<typename T>" << endl << "class List" << endl << "{" << endl
+      << "public:" << endl << "    List();" << endl << "};" << endl << endl;
+
+    for (int i = 0; i < shape.classes; ++i) {
+        // Classes form inheritance chains of the given depth.
+        bool derived = shape.inheritanceDepth > 1 && i % shape.inheritanceDepth;
+        s << "class " << className(i);
+        if (derived)
+            s << " : public " << className(i - 1);
+        s << endl << "{" << endl << "public:" << endl;
+        for (int e = 0; e < shape.enums; ++e) {
+            s << "    enum " << className(i) << "Enum" << e << " {";
+            for (int v = 0; v < 4; ++v)
+                s << (v ? ", " : " ") << className(i) << "Enum" << e << "Value" << v;
+            s << " };" << endl;
+        }
+        s << "    " << className(i) << "();" << endl;
+        s << "    virtual ~" << className(i) << "();" << endl;
+        for (int m = 0; m < shape.methods; ++m) {
+            switch (m % 3) {
+            case 0:
+                s << "    int method" << m << "(int value, double factor = 1.0);" << endl;
+                break;
+            case 1:
+                s << "    virtual void method" << m << "(" << className(i) << "* other, bool flag);" << endl;
+                break;
+            default:
+                s << "    static double method" << m << "(const " << className(i) << "& other);" << endl;
+            }
+        }
+        for (int c = 0; c < shape.containers; ++c) {
+            // Alternate between containers of primitives and of classes.
+            QString element = c % 2 ? className((i + c) % shape.classes) + '*' : QString("int");
+            s << "    List<" << element << " > values" << c << "() const;" << endl;
+            s << "    void setValues" << c << "(const List<" << element << " >& values);" << endl;
+        }
+        s << "};" << endl << endl;
+    }
+    s << "#endif" << endl;
+}
+
+static void writeTypeSystem(const QString& fileName, const QString& headerFileName, const ModelShape& shape)
+{
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream s(&file);
+    s << "<typesystem package='benchmark'>" << endl;
+    s << "    <primitive-type name='int'/>" << endl;
+    s << "    <primitive-type name='double'/>" << endl;
+    s << "    <primitive-type name='bool'/>" << endl;
+    s << "    <container-type name='List' type='list'>" << endl;
+    s << "        <include file-name='" << headerFileName << "' location='global'/>" << endl;
+    s << "    </container-type>" << endl;
+    for (int i = 0; i < shape.classes; ++i) {
+        s << "    <object-type name='" << className(i) << "'>" << endl;
+        for (int e = 0; e < shape.enums; ++e)
+            s << "        <enum-type name='" << className(i) << "Enum" << e << "'/>" << endl;
+        s << "    </object-type>" << endl;
+    }
+    s << "</typesystem>" << endl;
+}
+
+// Writes one file per class with the layout of the qdoc3 XML read by QtDocGenerator.
+static void writeDocumentation(const QString& dirName, const ModelShape& shape)
+{
+    QDir().mkpath(dirName);
+    for (int i = 0; i < shape.classes; ++i) {
+        QFile file(QString("%1/%2.xml").arg(dirName).arg(className(i).toLower()));
+        file.open(QIODevice::WriteOnly | QIODevice::Text);
+        QTextStream s(&file);
+        s << "<WebXML>" << endl << "<document>" << endl;
+        s << "<class name=\"" << className(i) << "\" fullname=\"" << className(i) << "\">" << endl;
+        s << "<description><para>The <teletype>" << className(i) << "</teletype> class is part of a "
+          << "synthetic benchmark. See also <link raw=\"" << className((i + 1) % shape.classes) << "\" href=\"\">"
+          << className((i + 1) % shape.classes) << "</link>.</para>" << endl;
+        s << "<code>" << className(i) << " object;\nobject.method0(1);</code>" << endl;
+        s << "<list type=\"bullet\"><item><para>First item.</para></item><item><para>Second item.</para></item></list>"
+          << endl << "</description>" << endl;
+        for (int m = 0; m < shape.methods; ++m) {
+            s << "<function name=\"method" << m << "\" fullname=\"" << className(i) << "::method" << m << "\">"
+              << "<description><para>Does the work number <argument>" << m << "</argument> and returns "
+              << "<bold>nothing</bold> of interest.</para></description></function>" << endl;
+        }
+        for (int e = 0; e < shape.enums; ++e) {
+            s << "<enum name=\"" << className(i) << "Enum" << e << "\" fullname=\"" << className(i) << "::"
+              << className(i) << "Enum" << e << "\"><description><para>An enumeration.</para></description></enum>"
+              << endl;
+        }
+        s << "</class>" << endl << "</document>" << endl << "</WebXML>" << endl;
+    }
+}
+
+static QString jsonString(const QString& value)
+{
+    QString result(value);
+    result.replace('\\', "\\\\").replace('"', "\\\"");
+    return '"' + result + '"';
+}
+
+static void removeDirectory(const QString& dirName)
+{
+    QDir dir(dirName);
+    foreach (const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot)) {
+        if (info.isDir())
+            removeDirectory(info.filePath());
+        else
+            dir.remove(info.fileName());
+    }
+    dir.rmdir(dir.absolutePath());
+}
+
+static RunResult runGenerator(const QString& generator, const QString& module, const QString& workDir,
+                              const ModelShape& shape, const QStringList& extraArgs)
+{
+    RunResult result;
+    result.generator = generator;
+    result.classes = shape.classes;
+    result.peakMemory = -1;
+
+    QString outputDir = QString("%1/out-%2").arg(workDir).arg(generator);
+    QString profileFileName = QString("%1/profile-%2.json").arg(workDir).arg(generator);
+    // Start from an empty output, so every run writes all files.
+    removeDirectory(outputDir);
+
+    QStringList args;
+    args << "--generator-set=" + module << "--output-directory=" + outputDir << "--profile=" + profileFileName;
+    if (generator == "qtdoc")
+        args << "--library-source-dir=" + workDir << "--documentation-data-dir=" + workDir + "/doc";
+    args << extraArgs << workDir + "/benchmark.h" << workDir + "/benchmark.xml";
+
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    QTime timer;
+    timer.start();
+    process.start(GENERATORRUNNER_BINARY, args);
+    result.ok = process.waitForFinished(-1) && process.exitStatus() == QProcess::NormalExit
+                && process.exitCode() == 0;
+    result.wall = timer.elapsed();
+    if (!result.ok)
+        return result;
+
+    QFile profileFile(profileFileName);
+    if (!profileFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return result;
+    QString profile = QString::fromUtf8(profileFile.readAll());
+    QRegExp memoryRegex("\"peakMemory\": (\\d+)");
+    if (memoryRegex.indexIn(profile) != -1)
+        result.peakMemory = memoryRegex.cap(1).toLongLong();
+    QRegExp totalRegex("\"([^\"]+)\": \\{ \"count\": (\\d+), \"wall\": (\\d+), \"cpu\": (\\d+), \"size\": (\\d+) \\}");
+    for (int pos = 0; (pos = totalRegex.indexIn(profile, pos)) != -1; pos += totalRegex.matchedLength()) {
+        QList<qint64>& values = result.phases[totalRegex.cap(1)];
+        for (int i = 2; i <= 5; ++i)
+            values << totalRegex.cap(i).toLongLong();
+    }
+    return result;
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: genbenchmark [options] [generatorrunner options]" << std::endl
+              << "  --sizes=<n>[,<n>...]        Number of classes of each run, defaults to 10,100,1000" << std::endl
+              << "  --methods=<n>               Methods per class, defaults to 10" << std::endl
+              << "  --enums=<n>                 Enums per class, defaults to 2" << std::endl
+              << "  --containers=<n>            Container accessors per class, defaults to 2" << std::endl
+              << "  --inheritance-depth=<n>     Length of the inheritance chains, defaults to 3" << std::endl
+              << "  --generators=<name>[,...]   Generators to run: dummy, qtdoc. Defaults to all" << std::endl
+              << "  --work-dir=<dir>            Where the inputs and outputs are written" << std::endl
+              << "  --output=<file>             Results file, defaults to genbenchmark.json" << std::endl
+              << "  --label=<text>              Label stored with the results, like a commit id" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QMap<QString, QString> options;
+    options["sizes"] = "10,100,1000";
+    options["methods"] = "10";
+    options["enums"] = "2";
+    options["containers"] = "2";
+    options["inheritance-depth"] = "3";
+    options["generators"] = QString(QTDOC_GENERATOR_MODULE).isEmpty() ? "dummy" : "dummy,qtdoc";
+    options["work-dir"] = QDir::tempPath() + "/genbenchmark";
+    options["output"] = "genbenchmark.json";
+    QStringList extraArgs;
+    foreach (const QString& arg, app.arguments().mid(1)) {
+        if (arg == "--help") {
+            printUsage();
+            return EXIT_SUCCESS;
+        }
+        int split = arg.indexOf('=');
+        QString key = arg.mid(2, split < 0 ? -1 : split - 2);
+        if (arg.startsWith("--") && options.contains(key) && split > 0)
+            options[key] = arg.mid(split + 1);
+        else
+            extraArgs << arg;
+    }
+
+    QMap<QString, QString> modules;
+    modules["dummy"] = DUMMY_GENERATOR_MODULE;
+    modules["qtdoc"] = QTDOC_GENERATOR_MODULE;
+    QStringList generators = options["generators"].split(',', QString::SkipEmptyParts);
+    foreach (const QString& generator, generators) {
+        if (modules.value(generator).isEmpty()) {
+            std::cerr << "Unknown generator: " << qPrintable(generator) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    ModelShape shape;
+    shape.methods = options["methods"].toInt();
+    shape.enums = options["enums"].toInt();
+    shape.containers = options["containers"].toInt();
+    shape.inheritanceDepth = options["inheritance-depth"].toInt();
+
+    QList<RunResult> results;
+    foreach (const QString& size, options["sizes"].split(',', QString::SkipEmptyParts)) {
+        shape.classes = size.toInt();
+        if (shape.classes < 1) {
+            std::cerr << "Invalid size: " << qPrintable(size) << std::endl;
+            return EXIT_FAILURE;
+        }
+        QString workDir = QString("%1/%2").arg(options["work-dir"]).arg(shape.classes);
+        QDir().mkpath(workDir);
+        writeHeader(workDir + "/benchmark.h", shape);
+        writeTypeSystem(workDir + "/benchmark.xml", workDir + "/benchmark.h", shape);
+        writeDocumentation(workDir + "/doc", shape);
+
+        foreach (const QString& generator, generators) {
+            RunResult result = runGenerator(generator, modules[generator], workDir, shape, extraArgs);
+            std::cout << qPrintable(generator) << ": " << shape.classes << " classes, ";
+            if (result.ok) {
+                std::cout << result.wall << " ms, "
+                          << (result.wall ? shape.classes * 1000.0 / result.wall : 0) << " classes/s";
+                if (result.peakMemory >= 0)
+                    std::cout << ", " << result.peakMemory / 1024 << " KB peak";
+            } else {
+                std::cout << "failed";
+            }
+            std::cout << std::endl;
+            results << result;
+        }
+    }
+
+    QFile outputFile(options["output"]);
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        std::cerr << "Can't write the results to " << qPrintable(options["output"]) << std::endl;
+        return EXIT_FAILURE;
+    }
+    QTextStream s(&outputFile);
+    s << "{" << endl;
+    s << "  \"label\": " << jsonString(options.value("label")) << ',' << endl;
+    s << "  \"shape\": { \"methods\": " << shape.methods << ", \"enums\": " << shape.enums
+      << ", \"containers\": " << shape.containers << ", \"inheritanceDepth\": " << shape.inheritanceDepth << " }," << endl;
+    s << "  \"arguments\": " << jsonString(extraArgs.join(" ")) << ',' << endl;
+    s << "  \"runs\": [";
+    bool failed = false;
+    for (int i = 0; i < results.size(); ++i) {
+        const RunResult& result = results[i];
+        failed |= !result.ok;
+        s << (i ? "," : "") << endl;
+        s << "    { \"generator\": " << jsonString(result.generator) << ", \"classes\": " << result.classes
+          << ", \"ok\": " << (result.ok ? "true" : "false") << ", \"wallMs\": " << result.wall;
+        if (result.ok && result.wall)
+            s << ", \"classesPerSecond\": " << result.classes * 1000.0 / result.wall;
+        if (result.peakMemory >= 0)
+            s << ", \"peakMemory\": " << result.peakMemory;
+        s << ", \"phases\": {";
+        QMap<QString, QList<qint64> >::const_iterator it = result.phases.constBegin();
+        for (; it != result.phases.constEnd(); ++it) {
+            s << (it == result.phases.constBegin() ? " " : ", ") << jsonString(it.key())
+              << ": { \"count\": " << it.value()[0] << ", \"wallUs\": " << it.value()[1]
+              << ", \"cpuUs\": " << it.value()[2] << ", \"size\": " << it.value()[3] << " }";
+        }
+        s << " } }";
+    }
+    s << endl << "  ]" << endl << "}" << endl;
+
+    std::cout << "Results written to " << qPrintable(options["output"]) << std::endl;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
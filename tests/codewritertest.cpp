@@ -0,0 +1,151 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "codewritertest.h"
+#include "codewriter.h"
+#include <QtTest/QTest>
+#include <QTextCodec>
+#include <climits>
+
+void CodeWriterTest::testAppend()
+{
+    CodeWriter writer;
+    QVERIFY(writer.isEmpty());
+    writer << "int " << QString("x") << QChar('[') << 16 << ']' << QByteArray(" = {};");
+    writer.append("\n// unused", 1);
+    QCOMPARE(writer.toByteArray(), QByteArray("int x[16] = {};\n"));
+    QCOMPARE(writer.size(), 16);
+    QVERIFY(!writer.isEmpty());
+}
+
+void CodeWriterTest::testNumbers()
+{
+    // Written as QTextStream writes them.
+    CodeWriter writer;
+    QString streamed;
+    QTextStream stream(&streamed);
+    writer << INT_MIN << ' ' << UINT_MAX << ' ' << LONG_MIN << ' ' << ULONG_MAX << ' '
+           << Q_INT64_C(-9223372036854775807) << ' ' << Q_UINT64_C(18446744073709551615) << ' '
+           << short(-7) << ' ' << ushort(7) << ' ' << qint64(0) << ' ' << 3u;
+    stream << INT_MIN << ' ' << UINT_MAX << ' ' << LONG_MIN << ' ' << ULONG_MAX << ' '
+           << Q_INT64_C(-9223372036854775807) << ' ' << Q_UINT64_C(18446744073709551615) << ' '
+           << short(-7) << ' ' << ushort(7) << ' ' << qint64(0) << ' ' << 3u;
+    stream.flush();
+    QCOMPARE(QString::fromUtf8(writer.toByteArray()), streamed);
+}
+
+void CodeWriterTest::testUtf8()
+{
+    // Text beyond ASCII is written as UTF-8, also after ASCII text in the same chunk.
+    CodeWriter writer;
+    QString text = QString::fromUtf8("// \xc3\xa9t\xc3\xa9 \xe2\x82\xac");
+    writer << "a" << text << QChar(0xe9) << QString("b");
+    QCOMPARE(writer.toByteArray(), "a" + text.toUtf8() + "\xc3\xa9" "b");
+    QCOMPARE(writer.size(), writer.toByteArray().size());
+}
+
+void CodeWriterTest::testIndentation()
+{
+    CodeWriter writer;
+    writer.indent() << "a;\n";
+    {
+        Indentation indentation(writer.indentor());
+        writer.indent() << "b;\n";
+        {
+            Indentation indentation(writer.indentor());
+            writer.indent() << "c;\n";
+        }
+        writer.indent() << "d;\n";
+    }
+    writer.indent() << "e;\n";
+    QCOMPARE(writer.toByteArray(), QByteArray("a;\n    b;\n        c;\n    d;\ne;\n"));
+
+    // Beyond the 16 levels of indentationSpaces(), like QTextStream does.
+    Indentor indentor;
+    indentor.indent = 33;
+    CodeWriter deepWriter;
+    deepWriter << indentor;
+    QString streamed;
+    QTextStream stream(&streamed);
+    stream << indentor;
+    stream.flush();
+    QCOMPARE(deepWriter.toByteArray(), QByteArray(33 * 4, ' '));
+    QCOMPARE(streamed, QString(33 * 4, ' '));
+}
+
+void CodeWriterTest::testChunks()
+{
+    // Code bigger than the first chunk is kept in more chunks, and joined when taken.
+    CodeWriter writer(16);
+    QByteArray expected;
+    for (int i = 0; i < 20000; ++i) {
+        writer << "line " << i << '\n';
+        expected += "line " + QByteArray::number(i) + '\n';
+    }
+    QByteArray big(100000, 'x');
+    writer << big;
+    expected += big;
+    QCOMPARE(writer.size(), expected.size());
+    QCOMPARE(writer.toByteArray(), expected);
+}
+
+void CodeWriterTest::testClear()
+{
+    CodeWriter writer;
+    writer << "old code";
+    writer.clear();
+    QVERIFY(writer.isEmpty());
+    writer << "new";
+    QCOMPARE(writer.toByteArray(), QByteArray("new"));
+}
+
+void CodeWriterTest::testStream()
+{
+    CodeWriter writer;
+    {
+        CodeWriterStream s(writer);
+        Indentor indentor;
+        Indentation indentation(indentor);
+        s << indentor << "int x = " << 42 << ';' << endl;
+        s.flush();
+        writer << "// direct\n";
+        s << "// streamed";
+    }
+    QCOMPARE(writer.toByteArray(), QByteArray("    int x = 42;\n// direct\n// streamed"));
+}
+
+void CodeWriterTest::testStreamEncoding()
+{
+    // The encoded text is read as Latin-1, so a Latin-1 stream writes UTF-8.
+    CodeWriter writer;
+    {
+        CodeWriterStream s(writer);
+        s.setCodec(QTextCodec::codecForName("ISO-8859-1"));
+        s << QString::fromUtf8("caf\xc3\xa9 ") << QString("plain");
+    }
+    QCOMPARE(writer.toByteArray(), QByteArray("caf\xc3\xa9 plain"));
+}
+
+QTEST_APPLESS_MAIN( CodeWriterTest )
+
+#include "codewritertest.moc"
@@ -0,0 +1,279 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "generatortest.h"
+#include "generator.h"
+#include <abstractmetalang.h>
+#include <apiextractor.h>
+#include <QtTest/QTest>
+#include <QDir>
+#include <QFile>
+
+static const char header[] = "\
+template<typename T> class List {};\n\
+struct Point\n\
+{\n\
+    Point(int x, int y);\n\
+};\n\
+class Canvas\n\
+{\n\
+public:\n\
+    void draw(const Point& a, Point& b, const Point* c, Point* d, Point e, const int& f, int g);\n\
+    int area(int scale) const;\n\
+    List<int> sizes(const List<int>& limits) const;\n\
+    class Layer\n\
+    {\n\
+    public:\n\
+        List<int> ids() const;\n\
+    };\n\
+};\n";
+
+static const char typesystem[] = "\
+<typesystem package='generatortest'>\n\
+    <primitive-type name='int'/>\n\
+    <container-type name='List' type='list'/>\n\
+    <value-type name='Point'/>\n\
+    <object-type name='Canvas'/>\n\
+    <object-type name='Canvas::Layer'/>\n\
+</typesystem>\n";
+
+/// Makes the protected helpers of Generator reachable by the tests.
+class TestGenerator : public Generator
+{
+public:
+    using Generator::translateType;
+    using Generator::replaceTemplateVariables;
+    using Generator::instantiatedContainers;
+    using Generator::containerUses;
+    using Generator::containersUsedBy;
+    const char* name() const { return "TestGenerator"; }
+
+protected:
+    void writeFunctionArguments(QTextStream& s, const AbstractMetaFunction* func, Options) const
+    {
+        foreach (const AbstractMetaArgument* arg, func->arguments())
+            s << (arg->argumentIndex() ? ", " : "") << translateType(arg->type(), func->ownerClass()) << ' ' << arg->name();
+    }
+    void writeArgumentNames(QTextStream& s, const AbstractMetaFunction* func, Options) const
+    {
+        foreach (const AbstractMetaArgument* arg, func->arguments())
+            s << (arg->argumentIndex() ? ", " : "") << arg->name();
+    }
+    QString fileNameForClass(const AbstractMetaClass*) const { return QString(); }
+    void generateClass(QTextStream&, const AbstractMetaClass*) {}
+    void finishGeneration() {}
+};
+
+static bool writeFile(const QString& fileName, const char* contents)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == qint64(qstrlen(contents));
+}
+
+/// Returns the type of an argument of Canvas::draw().
+static const AbstractMetaType* drawArgumentType(const Generator* generator, int index)
+{
+    const AbstractMetaClass* canvas = generator->findClassByCppName("Canvas");
+    if (!canvas)
+        return 0;
+    const AbstractMetaFunction* draw = canvas->findFunction("draw");
+    if (!draw || draw->arguments().size() <= index)
+        return 0;
+    return draw->arguments().at(index)->type();
+}
+
+void GeneratorTest::initTestCase()
+{
+    QString headerFileName = QDir::temp().filePath("generatortest_global.h");
+    QString typesystemFileName = QDir::temp().filePath("generatortest_typesystem.xml");
+    QVERIFY(writeFile(headerFileName, header));
+    QVERIFY(writeFile(typesystemFileName, typesystem));
+
+    m_extractor = new ApiExtractor;
+    m_extractor->setSilent(true);
+    m_extractor->setCppFileName(headerFileName);
+    m_extractor->setTypeSystem(typesystemFileName);
+    QVERIFY(m_extractor->run());
+
+    m_generator = new TestGenerator;
+    m_generator->setOutputDirectory(QDir::tempPath());
+    QVERIFY(m_generator->setup(*m_extractor, QMap<QString, QString>()));
+    QVERIFY(drawArgumentType(m_generator, 6));
+
+    QFile::remove(headerFileName);
+    QFile::remove(typesystemFileName);
+}
+
+void GeneratorTest::cleanupTestCase()
+{
+    delete m_generator;
+    delete m_extractor;
+}
+
+void GeneratorTest::testTranslateType()
+{
+    const AbstractMetaType* constReference = drawArgumentType(m_generator, 0);
+    QCOMPARE(m_generator->translateType(constReference, 0), QString("const Point &"));
+    QCOMPARE(m_generator->translateType(constReference, 0, Generator::ExcludeConst), QString("::Point &"));
+    QCOMPARE(m_generator->translateType(constReference, 0, Generator::ForceValueType), QString("::Point"));
+    QCOMPARE(m_generator->translateType(0, 0), QString("void"));
+
+    const AbstractMetaType* constPointer = drawArgumentType(m_generator, 2);
+    QCOMPARE(m_generator->translateType(constPointer, 0, Generator::ExcludeConst), QString("::Point *"));
+
+    // Primitive types are not qualified.
+    const AbstractMetaType* constPrimitiveReference = drawArgumentType(m_generator, 5);
+    QCOMPARE(m_generator->translateType(constPrimitiveReference, 0, Generator::ForceValueType), QString("int"));
+
+    // The translations are cached per type, context and options.
+    const AbstractMetaClass* canvas = m_generator->findClassByCppName("Canvas");
+    QCOMPARE(m_generator->translateType(constReference, canvas, Generator::ForceValueType), QString("::Point"));
+    QCOMPARE(m_generator->translateType(constReference, 0, Generator::ForceValueType), QString("::Point"));
+    QCOMPARE(m_generator->translateType(constReference, 0), QString("const Point &"));
+}
+
+void GeneratorTest::testTranslateTypeStripping_data()
+{
+    QTest::addColumn<int>("argument");
+    QTest::addColumn<int>("options");
+    for (int argument = 0; argument < 7; ++argument) {
+        QTest::newRow(qPrintable(QString("%1 ExcludeConst").arg(argument))) << argument << int(Generator::ExcludeConst);
+        QTest::newRow(qPrintable(QString("%1 ExcludeReference").arg(argument))) << argument << int(Generator::ExcludeReference);
+        QTest::newRow(qPrintable(QString("%1 ForceValueType").arg(argument))) << argument << int(Generator::ForceValueType);
+    }
+}
+
+void GeneratorTest::testTranslateTypeStripping()
+{
+    // The constness and reference are stripped from the signature, which must be
+    // the one of a copy of the type without them.
+    QFETCH(int, argument);
+    QFETCH(int, options);
+    const AbstractMetaType* type = drawArgumentType(m_generator, argument);
+    AbstractMetaType* copy = type->copy();
+    if (options & Generator::ExcludeConst)
+        copy->setConstant(false);
+    if (options & Generator::ExcludeReference)
+        copy->setReference(false);
+    QString expected = copy->cppSignature();
+    if (!copy->typeEntry()->isVoid() && !copy->typeEntry()->isCppPrimitive())
+        expected.prepend("::");
+    delete copy;
+    QCOMPARE(m_generator->translateType(type, 0, Generator::Options(options)), expected);
+}
+
+void GeneratorTest::testReplaceTemplateVariables_data()
+{
+    QTest::addColumn<QString>("function");
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expanded");
+    QTest::newRow("literal") << "draw" << "return 100%;" << "return 100%;";
+    QTest::newRow("empty") << "draw" << "" << "";
+    QTest::newRow("type") << "draw" << "%TYPE* self;" << "Canvas* self;";
+    QTest::newRow("arguments") << "draw" << "%2 = %1;" << "b = a;";
+    QTest::newRow("unknown argument") << "area" << "%1 + %2" << "scale + %2";
+    QTest::newRow("unknown variable") << "draw" << "%UNKNOWN %RETURN" << "%UNKNOWN %RETURN";
+    QTest::newRow("return type") << "area" << "%RETURN_TYPE r = %FUNCTION_NAME(%1);" << "int r = area(scale);";
+    QTest::newRow("void return type") << "draw" << "%RETURN_TYPE" << "void";
+    QTest::newRow("argument names") << "draw" << "%TYPE::%FUNCTION_NAME(%ARGUMENT_NAMES)"
+                                    << "Canvas::draw(a, b, c, d, e, f, g)";
+    QTest::newRow("function arguments") << "area" << "%RETURN_TYPE %FUNCTION_NAME(%ARGUMENTS)%ARGUMENTS"
+                                        << "int area(int scale)int scale";
+    QTest::newRow("adjacent") << "area" << "%1%1%TYPE%1" << "scalescaleCanvasscale";
+}
+
+void GeneratorTest::testReplaceTemplateVariables()
+{
+    // The snippets are compiled once, so each one is expanded for both functions.
+    QFETCH(QString, function);
+    QFETCH(QString, code);
+    QFETCH(QString, expanded);
+    const AbstractMetaClass* canvas = m_generator->findClassByCppName("Canvas");
+    const AbstractMetaFunction* other = canvas->findFunction(function == "draw" ? "area" : "draw");
+    QString otherCode = code;
+    m_generator->replaceTemplateVariables(otherCode, other);
+
+    QString result = code;
+    m_generator->replaceTemplateVariables(result, canvas->findFunction(function));
+    QCOMPARE(result, expanded);
+}
+
+void GeneratorTest::testFormatCode_data()
+{
+    QTest::addColumn<int>("indent");
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("formatted");
+    QTest::newRow("empty") << 1 << "" << "\n";
+    QTest::newRow("one line") << 1 << "foo();" << "    foo();\n";
+    QTest::newRow("no indentation") << 0 << "  foo();" << "foo();\n";
+    QTest::newRow("nested") << 1 << "    if (a)\n        b();\n" << "    if (a)\n        b();\n\n";
+    QTest::newRow("leading blank lines") << 1 << "\n\n  x;\n    y;" << "\n\n    x;\n      y;\n";
+    QTest::newRow("whitespace line") << 1 << "a;\n   \t\nb;" << "    a;\n\n    b;\n";
+    QTest::newRow("less indented line") << 1 << "    a;\nb;" << "    a;\n    b;\n";
+    QTest::newRow("partly indented line") << 1 << "    a;\n  b;" << "    a;\n    b;\n";
+    QTest::newRow("tabs") << 1 << "\tx;\n\t\ty;" << "    x;\n    \ty;\n";
+    QTest::newRow("trailing whitespace") << 1 << "a;  " << "    a;  \n";
+    QTest::newRow("carriage returns") << 1 << "  a;\r\n  b;\r\n" << "    a;\r\n    b;\r\n\n";
+    QTest::newRow("only blank lines") << 1 << "   \n  " << "\n\n";
+    QTest::newRow("deep indentation") << 17 << "a;" << QString(17 * 4, ' ') + "a;\n";
+}
+
+void GeneratorTest::testFormatCode()
+{
+    QFETCH(int, indent);
+    QFETCH(QString, code);
+    QFETCH(QString, formatted);
+    QString result;
+    QTextStream s(&result);
+    Indentor indentor;
+    indentor.indent = indent;
+    formatCode(s, code, indentor);
+    s.flush();
+    QCOMPARE(result, formatted);
+}
+
+void GeneratorTest::testContainerUses()
+{
+    // A second setup starts over, and the inner class, walked both by itself and with
+    // Canvas, and Canvas::sizes(), using List<int> twice, are recorded once each.
+    QVERIFY(m_generator->setup(*m_extractor, QMap<QString, QString>()));
+    QCOMPARE(m_generator->instantiatedContainers().size(), 1);
+    QString containerName = Generator::getSimplifiedContainerTypeName(m_generator->instantiatedContainers().first());
+
+    const AbstractMetaClass* canvas = m_generator->findClassByCppName("Canvas");
+    const AbstractMetaClass* layer = m_generator->findClassByCppName("Canvas::Layer");
+    QVERIFY(canvas && layer);
+    QList<Generator::ContainerUse> uses = m_generator->containerUses(containerName);
+    QCOMPARE(uses.size(), 2);
+    int canvasUse = uses[0].metaClass == canvas ? 0 : 1;
+    QVERIFY(uses[canvasUse].metaClass == canvas);
+    QVERIFY(uses[canvasUse].function == canvas->findFunction("sizes"));
+    QVERIFY(uses[1 - canvasUse].metaClass == layer);
+    QVERIFY(uses[1 - canvasUse].function == layer->findFunction("ids"));
+    QCOMPARE(m_generator->containersUsedBy(canvas), QStringList() << containerName);
+    QCOMPARE(m_generator->containersUsedBy(layer), QStringList() << containerName);
+}
+
+QTEST_MAIN( GeneratorTest )
+
+#include "generatortest.moc"
@@ -0,0 +1,52 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GENERATORTEST_H
+#define GENERATORTEST_H
+
+#include <QObject>
+
+class ApiExtractor;
+class TestGenerator;
+
+/// Tests the helpers Generator offers to the generators, on a small model parsed once.
+class GeneratorTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testTranslateType();
+    void testTranslateTypeStripping_data();
+    void testTranslateTypeStripping();
+    void testReplaceTemplateVariables_data();
+    void testReplaceTemplateVariables();
+    void testFormatCode_data();
+    void testFormatCode();
+    void testContainerUses();
+private:
+    ApiExtractor* m_extractor;
+    TestGenerator* m_generator;
+};
+
+#endif
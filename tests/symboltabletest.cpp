@@ -0,0 +1,117 @@
+/*
+ * This file is part of the PySide project.
+ *
+ * Copyright (C) 2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: PySide team <contact@pyside.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "symboltabletest.h"
+#include "symboltable.h"
+#include <QtTest/QTest>
+#include <QtConcurrentRun>
+#include <QFuture>
+
+void SymbolTableTest::testSymbols()
+{
+    SymbolTable table;
+    int a = table.symbol("Package.A");
+    int b = table.symbol("Package.B");
+    QVERIFY(a != b);
+    QCOMPARE(table.symbol(QString("Package.") + 'A'), a);
+    QCOMPARE(table.name(a), QString("Package.A"));
+    QCOMPARE(table.name(b), QString("Package.B"));
+    QVERIFY(table.name(b + 1).isNull());
+}
+
+void SymbolTableTest::testIntern()
+{
+    // Equal names share the data kept by the table.
+    SymbolTable table;
+    QString first = table.intern(QString("::Namespace::") + "Class");
+    QString second = table.intern(QString("::Namespace::Class"));
+    QCOMPARE(first, QString("::Namespace::Class"));
+    QCOMPARE(first.constData(), second.constData());
+}
+
+void SymbolTableTest::testObjectNames()
+{
+    // Names are kept per kind, object and signature.
+    SymbolTable table;
+    int object;
+    int other;
+    QCOMPARE(table.findName(SymbolTable::FullTypeName, &object), -1);
+    int symbol = table.addName(SymbolTable::FullTypeName, &object, QString(), "::Point");
+    QCOMPARE(table.findName(SymbolTable::FullTypeName, &object), symbol);
+    QCOMPARE(table.name(symbol), QString("::Point"));
+    QCOMPARE(table.findName(SymbolTable::TargetName, &object), -1);
+    QCOMPARE(table.findName(SymbolTable::FullTypeName, &other), -1);
+    QCOMPARE(table.findName(SymbolTable::FullTypeName, &object, "const Point &"), -1);
+
+    int reference = table.addName(SymbolTable::FullTypeName, &object, "const Point &", "::Point");
+    QCOMPARE(reference, symbol);
+    QCOMPARE(table.findName(SymbolTable::FullTypeName, &object, "const Point &"), symbol);
+    QCOMPARE(table.symbol("::Point"), symbol);
+}
+
+void SymbolTableTest::testFirstNameStays()
+{
+    SymbolTable table;
+    int object;
+    int symbol = table.addName(SymbolTable::TargetName, &object, QString(), "First");
+    QCOMPARE(table.addName(SymbolTable::TargetName, &object, QString(), "Second"), symbol);
+    QCOMPARE(table.name(table.findName(SymbolTable::TargetName, &object)), QString("First"));
+}
+
+void SymbolTableTest::testClear()
+{
+    SymbolTable table;
+    int object;
+    int symbol = table.addName(SymbolTable::TargetFullName, &object, QString(), "Package.Object");
+    table.symbol("Package.Other");
+    table.clear();
+    QCOMPARE(table.findName(SymbolTable::TargetFullName, &object), -1);
+    QVERIFY(table.name(symbol).isNull());
+    QCOMPARE(table.symbol("Package.Other"), 0);
+}
+
+static QList<int> internNames(SymbolTable* table)
+{
+    QList<int> symbols;
+    for (int i = 0; i < 1000; ++i)
+        symbols << table->symbol(QString("Name%1").arg(i));
+    return symbols;
+}
+
+void SymbolTableTest::testConcurrentSymbols()
+{
+    // Threads interning the same names get the same symbols.
+    SymbolTable table;
+    QList<QFuture<QList<int> > > futures;
+    for (int i = 0; i < 4; ++i)
+        futures << QtConcurrent::run(internNames, &table);
+    QList<int> symbols = futures.first().result();
+    foreach (QFuture<QList<int> > future, futures)
+        QCOMPARE(future.result(), symbols);
+    for (int i = 0; i < symbols.size(); ++i)
+        QCOMPARE(table.name(symbols[i]), QString("Name%1").arg(i));
+}
+
+QTEST_MAIN( SymbolTableTest )
+
+#include "symboltabletest.moc"
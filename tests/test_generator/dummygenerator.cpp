@@ -22,9 +22,11 @@
  */
 
 #include <iostream>
+#include <QtCore/QFileInfo>
+#include <reporthandler.h>
 #include "dummygenerator.h"
 
-EXPORT_GENERATOR_PLUGIN(new DummyGenerator)
+EXPORT_GENERATOR_PLUGIN(new DummyGenerator << new UnsafeDummyGenerator << new UnityDummyGenerator)
 
 using namespace std;
 
@@ -38,11 +40,53 @@ void
 DummyGenerator::generateClass(QTextStream& s, const AbstractMetaClass* metaClass)
 {
     s << "// Generated code for class: " << qPrintable(metaClass->name()) << endl;
+    if (!m_writeSignatures)
+        return;
+    foreach (const AbstractMetaFunction* func, metaClass->functions()) {
+        s << "// " << func->name() << '(';
+        foreach (const AbstractMetaArgument* arg, func->arguments()) {
+            if (arg->argumentIndex())
+                s << ", ";
+            s << translateType(arg->type(), metaClass) << " = " << minimalConstructor(arg->type());
+        }
+        s << ") -> " << (func->type() ? getFullTypeName(func->type()) : QString("void")) << endl;
+    }
+}
+
+void
+DummyGenerator::finishGeneration()
+{
+    if (!m_inputFileName.isEmpty()) {
+        QFile inputFile(m_inputFileName);
+        if (inputFile.open(QIODevice::ReadOnly)) {
+            addInputFile(QFileInfo(inputFile).absoluteFilePath());
+            writeOutputFile(outputDirectory() + "/dummy_input.txt", inputFile.readAll());
+        }
+    }
+    if (m_writeFinishFile) {
+        // Written by itself, like the generators using FileOut, instead of with writeOutputFile().
+        QFile file(outputDirectory() + "/dummy_finish.txt");
+        if (file.open(QIODevice::WriteOnly))
+            file.write("// Finished\n");
+    }
+}
+
+QMap<QString, QString>
+DummyGenerator::options() const
+{
+    QMap<QString, QString> options;
+    options.insert("dummy-signatures", "Also write the signatures of the functions of each class");
+    options.insert("dummy-finish-file", "Also write dummy_finish.txt when finishing, without writeOutputFile()");
+    options.insert("dummy-input-file", "Copy the given file into dummy_input.txt when finishing, recording it as an input");
+    return options;
 }
 
 bool
 DummyGenerator::doSetup(const QMap<QString, QString>& args)
 {
+    m_writeSignatures = args.contains("dummy-signatures");
+    m_writeFinishFile = args.contains("dummy-finish-file");
+    m_inputFileName = args.value("dummy-input-file");
     if (args.contains("dump-arguments") && !args["dump-arguments"].isEmpty()) {
         QFile logFile(args["dump-arguments"]);
         logFile.open(QIODevice::WriteOnly | QIODevice::Text);
@@ -62,3 +106,75 @@ DummyGenerator::doSetup(const QMap<QString, QString>& args)
     return true;
 }
 
+
+QString
+UnsafeDummyGenerator::fileNameForClass(const AbstractMetaClass* metaClass) const
+{
+    return QString("%1_unsafe.txt").arg(metaClass->name().toLower());
+}
+
+void
+UnsafeDummyGenerator::generateClass(QTextStream& s, const AbstractMetaClass* metaClass)
+{
+    ReportHandler::debugSparse(QString("unsafe class %1: %2").arg(++m_generatedClasses).arg(metaClass->name()));
+    s << "// Class " << m_generatedClasses << ": " << qPrintable(metaClass->name()) << endl;
+}
+
+bool
+UnsafeDummyGenerator::shouldGenerate(const AbstractMetaClass* metaClass) const
+{
+    return m_enabled && Generator::shouldGenerate(metaClass);
+}
+
+QMap<QString, QString>
+UnsafeDummyGenerator::options() const
+{
+    QMap<QString, QString> options;
+    options.insert("dummy-unsafe", "Also number the classes with a generator that is not thread safe");
+    return options;
+}
+
+bool
+UnsafeDummyGenerator::doSetup(const QMap<QString, QString>& args)
+{
+    m_enabled = args.contains("dummy-unsafe");
+    m_generatedClasses = 0;
+    return true;
+}
+
+
+QString
+UnityDummyGenerator::fileNameForClass(const AbstractMetaClass* metaClass) const
+{
+    return QString("%1_wrapper.cpp").arg(metaClass->name().toLower());
+}
+
+void
+UnityDummyGenerator::generateClass(QTextStream& s, const AbstractMetaClass* metaClass)
+{
+    // The names are unique among the classes, so the files can be compiled as one.
+    s << "// Generated code for class: " << qPrintable(metaClass->name()) << endl;
+    s << "static const int " << metaClass->name().toLower() << "_functions = "
+      << metaClass->functions().size() << ';' << endl;
+}
+
+bool
+UnityDummyGenerator::shouldGenerate(const AbstractMetaClass* metaClass) const
+{
+    return m_enabled && Generator::shouldGenerate(metaClass);
+}
+
+QMap<QString, QString>
+UnityDummyGenerator::options() const
+{
+    QMap<QString, QString> options;
+    options.insert("dummy-unity", "Also write a C++ source for each class, which can be bundled with --unity-files");
+    return options;
+}
+
+bool
+UnityDummyGenerator::doSetup(const QMap<QString, QString>& args)
+{
+    m_enabled = args.contains("dummy-unity");
+    return true;
+}
@@ -28,10 +28,65 @@
 class GENRUNNER_API DummyGenerator : public Generator
 {
 public:
-    DummyGenerator() {}
+    DummyGenerator() : m_writeSignatures(false), m_writeFinishFile(false) {}
     ~DummyGenerator() {}
     bool doSetup(const QMap<QString, QString>& args);
+    QMap<QString, QString> options() const;
     const char* name() const { return "DummyGenerator"; }
+    Capabilities capabilities() const
+    {
+        return Capabilities(ThreadSafeGeneration) | IncrementalGeneration | ShardedGeneration;
+    }
+
+protected:
+    void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
+    void writeArgumentNames(QTextStream&, const AbstractMetaFunction*, Options) const {}
+    QString fileNameForClass(const AbstractMetaClass* metaClass) const;
+    void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
+    void finishGeneration();
+
+private:
+    bool m_writeSignatures;
+    bool m_writeFinishFile;
+    QString m_inputFileName;
+};
+
+// Numbers the classes in the order they are generated, so it is not thread safe.
+// Generates nothing unless --dummy-unsafe is given.
+class GENRUNNER_API UnsafeDummyGenerator : public Generator
+{
+public:
+    UnsafeDummyGenerator() : m_enabled(false), m_generatedClasses(0) {}
+    ~UnsafeDummyGenerator() {}
+    bool doSetup(const QMap<QString, QString>& args);
+    QMap<QString, QString> options() const;
+    const char* name() const { return "UnsafeDummyGenerator"; }
+    bool shouldGenerate(const AbstractMetaClass* metaClass) const;
+
+protected:
+    void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
+    void writeArgumentNames(QTextStream&, const AbstractMetaFunction*, Options) const {}
+    QString fileNameForClass(const AbstractMetaClass* metaClass) const;
+    void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
+    void finishGeneration() {}
+
+private:
+    bool m_enabled;
+    int m_generatedClasses;
+};
+
+// Writes a C++ source for each class, so the files can be bundled by --unity-files.
+// Generates nothing unless --dummy-unity is given.
+class GENRUNNER_API UnityDummyGenerator : public Generator
+{
+public:
+    UnityDummyGenerator() : m_enabled(false) {}
+    ~UnityDummyGenerator() {}
+    bool doSetup(const QMap<QString, QString>& args);
+    QMap<QString, QString> options() const;
+    const char* name() const { return "UnityDummyGenerator"; }
+    Capabilities capabilities() const { return Capabilities(ThreadSafeGeneration) | UnityGeneration; }
+    bool shouldGenerate(const AbstractMetaClass* metaClass) const;
 
 protected:
     void writeFunctionArguments(QTextStream&, const AbstractMetaFunction*, Options) const {}
@@ -39,6 +94,9 @@ protected:
     QString fileNameForClass(const AbstractMetaClass* metaClass) const;
     void generateClass(QTextStream& s, const AbstractMetaClass* metaClass);
     void finishGeneration() {}
+
+private:
+    bool m_enabled;
 };
 
 #endif // DUMMYGENERATOR_H
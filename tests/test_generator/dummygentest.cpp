@@ -30,24 +30,75 @@
 
 #define GENERATED_CONTENTS  "// Generated code for class: Dummy"
 
+static void removeDirectory(const QString& dirName)
+{
+    QDir dir(dirName);
+    foreach (const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot)) {
+        if (info.isDir())
+            removeDirectory(info.filePath());
+        else
+            dir.remove(info.fileName());
+    }
+    dir.rmdir(dir.absolutePath());
+}
+
+static bool replaceInFile(const QString& fileName, const QByteArray& before, const QByteArray& after)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray contents = file.readAll();
+    file.close();
+    if (!contents.contains(before) || !file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(contents.replace(before, after)) == contents.size();
+}
+
+/// Returns the contents of the files in a directory by their names.
+static QMap<QString, QByteArray> readFiles(const QString& dirName)
+{
+    QMap<QString, QByteArray> files;
+    foreach (const QFileInfo& info, QDir(dirName).entryInfoList(QDir::Files)) {
+        QFile file(info.filePath());
+        if (file.open(QIODevice::ReadOnly))
+            files.insert(info.fileName(), file.readAll());
+    }
+    return files;
+}
+
 void DummyGenTest::initTestCase()
 {
     int argc = 0;
     char* argv[] = {NULL};
     QCoreApplication app(argc, argv);
     workDir = QDir::currentPath();
+    outputDirPath = QDir::temp().filePath("dummygentest-output");
 
     headerFilePath = workDir + "/test_global.h";
     typesystemFilePath = workDir + "/test_typesystem.xml";
     projectFilePath = workDir + "/dummygentest-project.txt";
-    generatedFilePath = QString("%1/dummy/dummy_generated.txt").arg(QDir::tempPath());
+    generatedFilePath = outputDirPath + "/dummy/dummy_generated.txt";
+    shapesHeaderFilePath = workDir + "/test_shapes.h";
+    shapesTypesystemFilePath = workDir + "/test_shapes_typesystem.xml";
+}
+
+// Tests sharing the default output directory get an empty one each time, so the
+// manifests, logs and shard data they leave behind never reach the next test.
+void DummyGenTest::init()
+{
+    removeDirectory(outputDirPath);
+}
+
+void DummyGenTest::cleanup()
+{
+    removeDirectory(outputDirPath);
 }
 
 void DummyGenTest::testCallGenRunnerWithFullPathToDummyGenModule()
 {
     QStringList args;
     args.append("--generator-set=" DUMMYGENERATOR_BINARY_DIR "/dummy_generator" MODULE_EXTENSION);
-    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append("--output-directory=" + outputDirPath);
     args.append(headerFilePath);
     args.append(typesystemFilePath);
     int result = QProcess::execute("generatorrunner", args);
@@ -65,7 +116,7 @@ void DummyGenTest::testCallGenRunnerWithNameOfDummyGenModule()
 {
     QStringList args;
     args.append("--generator-set=dummy");
-    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append("--output-directory=" + outputDirPath);
     args.append(headerFilePath);
     args.append(typesystemFilePath);
     int result = QProcess::execute("generatorrunner", args);
@@ -82,7 +133,7 @@ void DummyGenTest::testCallGenRunnerWithNameOfDummyGenModule()
 void DummyGenTest::testCallDummyGeneratorExecutable()
 {
     QStringList args;
-    args.append(QString("--output-directory=%1").arg(QDir::tempPath()));
+    args.append("--output-directory=" + outputDirPath);
     args.append(headerFilePath);
     args.append(typesystemFilePath);
     int result = QProcess::execute(DUMMYGENERATOR_BINARY, args);
@@ -96,6 +147,660 @@ void DummyGenTest::testCallDummyGeneratorExecutable()
     QVERIFY(generatedFile.remove());
 }
 
+void DummyGenTest::testCallGenRunnerWithMultipleJobs()
+{
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--jobs=4");
+    args.append("--output-directory=" + outputDirPath);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QVERIFY(generatedFile.remove());
+}
+
+void DummyGenTest::testMultipleJobsWithSharedTypes()
+{
+    // All the shapes use Point, whose signature and minimal constructor are asked by
+    // every generation thread at the same time.
+    QString outputDir = QDir::temp().filePath("dummygentest-shapes");
+    QMap<QString, QByteArray> serialFiles;
+    for (int run = 0; run < 4; ++run) {
+        removeDirectory(outputDir);
+        QStringList args;
+        args.append("--generator-set=dummy");
+        args.append("--dummy-signatures");
+        args.append(run ? "--jobs=8" : "--jobs=1");
+        args.append("--output-directory=" + outputDir);
+        args.append(shapesHeaderFilePath);
+        args.append(shapesTypesystemFilePath);
+        int result = QProcess::execute("generatorrunner", args);
+        QCOMPARE(result, 0);
+
+        QMap<QString, QByteArray> files = readFiles(outputDir + "/shapes");
+        if (!run) {
+            QCOMPARE(files.size(), 17);
+            QVERIFY(files.value("shape0_generated.txt").contains("// move("));
+            serialFiles = files;
+        } else {
+            QVERIFY(files == serialFiles);
+        }
+    }
+    removeDirectory(outputDir);
+}
+
+void DummyGenTest::testMultipleJobsWithUnsafeGenerator()
+{
+    // The unsafe generator numbers the classes as it generates them, so the files and the
+    // report are the ones of a serial run only if it never runs alongside the workers.
+    QString outputDir = QDir::temp().filePath("dummygentest-unsafe");
+    QMap<QString, QByteArray> serialFiles;
+    QList<QByteArray> serialReport;
+    for (int run = 0; run < 3; ++run) {
+        removeDirectory(outputDir);
+        QStringList args;
+        args.append("--generator-set=dummy");
+        args.append("--dummy-unsafe");
+        args.append("--single-pass");
+        args.append("--debug-level=sparse");
+        args.append(run ? "--jobs=4" : "--jobs=1");
+        args.append("--output-directory=" + outputDir);
+        args.append(shapesHeaderFilePath);
+        args.append(shapesTypesystemFilePath);
+        QProcess generator;
+        generator.start("generatorrunner", args);
+        QVERIFY(generator.waitForFinished());
+        QCOMPARE(generator.exitCode(), 0);
+
+        QList<QByteArray> report;
+        foreach (const QByteArray& line, generator.readAllStandardOutput().split('\n')) {
+            if (line.contains("generating:") || line.contains("unsafe class"))
+                report << line.trimmed();
+        }
+        QMap<QString, QByteArray> files = readFiles(outputDir + "/shapes");
+        if (!run) {
+            QCOMPARE(files.size(), 34);
+            QVERIFY(files.value("shape0_unsafe.txt").contains(": Shape0"));
+            QCOMPARE(report.size(), 51);
+            serialFiles = files;
+            serialReport = report;
+        } else {
+            QVERIFY(files == serialFiles);
+            QCOMPARE(report, serialReport);
+        }
+    }
+    removeDirectory(outputDir);
+}
+
+void DummyGenTest::testMultipleJobsWithoutClasses()
+{
+    QString headerCopy = QDir::temp().filePath("dummygentest-functions.h");
+    QString typesystemCopy = QDir::temp().filePath("dummygentest-functions.xml");
+    QFile header(headerCopy);
+    QVERIFY(header.open(QIODevice::WriteOnly));
+    header.write("int answer();\n");
+    header.close();
+    QFile typesystem(typesystemCopy);
+    QVERIFY(typesystem.open(QIODevice::WriteOnly));
+    typesystem.write("<typesystem package='functions'>\n"
+                     "    <primitive-type name='int'/>\n"
+                     "    <function signature='answer()'/>\n"
+                     "</typesystem>\n");
+    typesystem.close();
+
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--jobs=4");
+    args.append("--output-directory=" + outputDirPath);
+    args.append(headerCopy);
+    args.append(typesystemCopy);
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    QVERIFY(header.remove());
+    QVERIFY(typesystem.remove());
+}
+
+void DummyGenTest::testIncrementalGeneration()
+{
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--incremental");
+    args.append("--output-directory=" + outputDirPath);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QFile manifestFile(outputDirPath + "/.DummyGenerator.manifest");
+    manifestFile.remove();
+
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QVERIFY(manifestFile.exists());
+
+    // A missing output file must be generated again even if the class didn't change.
+    QFile generatedFile(generatedFilePath);
+    QVERIFY(generatedFile.remove());
+    result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    // So must a file truncated since it was generated.
+    QVERIFY(generatedFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    generatedFile.close();
+    result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QVERIFY(generatedFile.remove());
+    QVERIFY(manifestFile.remove());
+}
+
+void DummyGenTest::testIncrementalGenerationFollowsDependencies()
+{
+    // The shapes are generated from copies of their inputs, changed between the runs.
+    QString outputDir = QDir::temp().filePath("dummygentest-incremental");
+    QString fullOutputDir = QDir::temp().filePath("dummygentest-full");
+    QString headerCopy = QDir::temp().filePath("dummygentest-shapes.h");
+    QString typesystemCopy = QDir::temp().filePath("dummygentest-shapes.xml");
+    removeDirectory(outputDir);
+    removeDirectory(fullOutputDir);
+    QFile::remove(headerCopy);
+    QFile::remove(typesystemCopy);
+    QVERIFY(QFile::copy(shapesHeaderFilePath, headerCopy));
+    QVERIFY(QFile::copy(shapesTypesystemFilePath, typesystemCopy));
+
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--dummy-signatures");
+    args.append(headerCopy);
+    args.append(typesystemCopy);
+    QStringList incrementalArgs = args;
+    incrementalArgs.append("--incremental");
+    incrementalArgs.append("--output-directory=" + outputDir);
+    int result = QProcess::execute("generatorrunner", incrementalArgs);
+    QCOMPARE(result, 0);
+    QByteArray shapeBefore = readFiles(outputDir + "/shapes").value("shape0_generated.txt");
+    QVERIFY(!shapeBefore.isEmpty());
+
+    // Point needs one more argument, which changes the minimal constructor used by
+    // every shape without changing the shapes themselves, and Shape15 is dropped.
+    QVERIFY(replaceInFile(headerCopy, "Point(int x, int y);", "Point(int x, int y, int z);"));
+    QVERIFY(replaceInFile(typesystemCopy, "    <object-type name='Shape15'/>\n", ""));
+    result = QProcess::execute("generatorrunner", incrementalArgs);
+    QCOMPARE(result, 0);
+    QMap<QString, QByteArray> files = readFiles(outputDir + "/shapes");
+    QVERIFY(!files.contains("shape15_generated.txt"));
+    QVERIFY(files.value("shape0_generated.txt") != shapeBefore);
+
+    // The incremental run left what a full run writes.
+    QStringList fullArgs = args;
+    fullArgs.append("--output-directory=" + fullOutputDir);
+    result = QProcess::execute("generatorrunner", fullArgs);
+    QCOMPARE(result, 0);
+    QVERIFY(readFiles(fullOutputDir + "/shapes") == files);
+
+    removeDirectory(outputDir);
+    removeDirectory(fullOutputDir);
+    QVERIFY(QFile::remove(headerCopy));
+    QVERIFY(QFile::remove(typesystemCopy));
+}
+
+// Returns the files included by each unity file of a directory, by unity file name.
+static QMap<QString, QList<QByteArray> > readUnityFiles(const QString& dirName)
+{
+    QMap<QString, QList<QByteArray> > bundles;
+    QMap<QString, QByteArray> files = readFiles(dirName);
+    for (QMap<QString, QByteArray>::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+        if (!it.key().contains("_unity_"))
+            continue;
+        QList<QByteArray>& includes = bundles[it.key()];
+        foreach (const QByteArray& line, it.value().split('\n')) {
+            if (line.startsWith("#include "))
+                includes << line;
+        }
+    }
+    return bundles;
+}
+
+void DummyGenTest::testUnityFiles()
+{
+    QString outputDir = QDir::temp().filePath("dummygentest-unity");
+    QString typesystemCopy = QDir::temp().filePath("dummygentest-unity.xml");
+    removeDirectory(outputDir);
+    QFile::remove(typesystemCopy);
+    QVERIFY(QFile::copy(shapesTypesystemFilePath, typesystemCopy));
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--dummy-unity");
+    args.append("--output-directory=" + outputDir);
+    args.append(shapesHeaderFilePath);
+    args.append(typesystemCopy);
+
+    // The 17 classes, all but Point with the same functions, are balanced among the bundles.
+    int result = QProcess::execute("generatorrunner", QStringList(args) << "--unity-files=4");
+    QCOMPARE(result, 0);
+    QMap<QString, QList<QByteArray> > bundles = readUnityFiles(outputDir + "/shapes");
+    QCOMPARE(bundles.size(), 4);
+    QSet<QByteArray> included;
+    foreach (const QList<QByteArray>& includes, bundles) {
+        QVERIFY(includes.size() >= 4 && includes.size() <= 5);
+        included += includes.toSet();
+    }
+    QCOMPARE(included.size(), 17);
+    QVERIFY(included.contains("#include \"shape0_wrapper.cpp\""));
+
+    // The other generators write no bundles of their files.
+    foreach (const QByteArray& include, included)
+        QVERIFY(include.endsWith(".cpp\""));
+
+    // Without Shape15, the other classes stay in their bundles.
+    QVERIFY(replaceInFile(typesystemCopy, "    <object-type name='Shape15'/>\n", ""));
+    result = QProcess::execute("generatorrunner", QStringList(args) << "--unity-files=4");
+    QCOMPARE(result, 0);
+    QMap<QString, QList<QByteArray> > newBundles = readUnityFiles(outputDir + "/shapes");
+    QCOMPARE(newBundles.size(), 4);
+    foreach (const QString& bundle, bundles.keys()) {
+        QList<QByteArray> expected = bundles[bundle];
+        expected.removeAll("#include \"shape15_wrapper.cpp\"");
+        QCOMPARE(newBundles[bundle], expected);
+    }
+
+    // Fewer bundles remove the extra ones.
+    result = QProcess::execute("generatorrunner", QStringList(args) << "--unity-files=2");
+    QCOMPARE(result, 0);
+    newBundles = readUnityFiles(outputDir + "/shapes");
+    QCOMPARE(newBundles.size(), 2);
+    included.clear();
+    foreach (const QList<QByteArray>& includes, newBundles)
+        included += includes.toSet();
+    QCOMPARE(included.size(), 16);
+
+    removeDirectory(outputDir);
+    QVERIFY(QFile::remove(typesystemCopy));
+}
+
+void DummyGenTest::testOutputManifest()
+{
+    QString outputDir = QDir::temp().filePath("dummygentest-output-manifest");
+    QString typesystemCopy = QDir::temp().filePath("dummygentest-output-manifest.xml");
+    removeDirectory(outputDir);
+    QFile::remove(typesystemCopy);
+    QVERIFY(QFile::copy(shapesTypesystemFilePath, typesystemCopy));
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDir);
+    args.append(shapesHeaderFilePath);
+    args.append(typesystemCopy);
+    QFile manifestFile(outputDir + "/.DummyGenerator.outputs");
+
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QVERIFY(manifestFile.open(QIODevice::ReadOnly));
+    QByteArray manifest = manifestFile.readAll();
+    manifestFile.close();
+    QVERIFY(manifest.contains("/shapes/shape14_generated.txt\n"));
+    QVERIFY(manifest.contains("/shapes/shape15_generated.txt\n"));
+
+    // Shape15 is not generated anymore, and the file of Shape14 was removed and written again.
+    QVERIFY(replaceInFile(typesystemCopy, "    <object-type name='Shape15'/>\n", ""));
+    QVERIFY(QFile::remove(outputDir + "/shapes/shape14_generated.txt"));
+    result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QVERIFY(manifestFile.open(QIODevice::ReadOnly));
+    manifest = manifestFile.readAll();
+    manifestFile.close();
+    QVERIFY(manifest.contains("/shapes/shape13_generated.txt\n"));
+    QVERIFY(manifest.contains("/shapes/shape14_generated.txt\n"));
+    QVERIFY(!manifest.contains("/shapes/shape15_generated.txt\n"));
+
+    // A file edited without changing its size, usually within the second it was written
+    // and recorded, is written again.
+    QString shapeFile = outputDir + "/shapes/shape13_generated.txt";
+    QByteArray shapeBefore = readFiles(outputDir + "/shapes").value("shape13_generated.txt");
+    QVERIFY(replaceInFile(shapeFile, "Shape13", "Shape31"));
+    result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QCOMPARE(readFiles(outputDir + "/shapes").value("shape13_generated.txt"), shapeBefore);
+
+    removeDirectory(outputDir);
+    QVERIFY(QFile::remove(typesystemCopy));
+}
+
+void DummyGenTest::testModelCache()
+{
+    QString cacheDir = QDir::temp().filePath("dummygentest-model-cache");
+    QString outputDir = QDir::temp().filePath("dummygentest-model-cache-output");
+    QString generatedFile = outputDir + "/dummy/dummy_generated.txt";
+    QString headerCopy = QDir::temp().filePath("dummygentest-global.h");
+    removeDirectory(cacheDir);
+    removeDirectory(outputDir);
+    QFile::remove(headerCopy);
+    QVERIFY(QFile::copy(headerFilePath, headerCopy));
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDir);
+    args.append("--model-cache=" + cacheDir);
+    args.append(headerCopy);
+    args.append(typesystemFilePath);
+
+    // Whether each run skips the generation: the second one has the inputs and outputs
+    // of the first one, the third one misses the output file, and the last one has the
+    // header edited without changing its size, usually within the second of the last run.
+    bool skipped[] = { false, true, false, false };
+    for (int run = 0; run < 4; ++run) {
+        if (run == 2)
+            QVERIFY(QFile::remove(generatedFile));
+        if (run == 3)
+            QVERIFY(replaceInFile(headerCopy, "struct Dummy {};", "struct Dummy{ };"));
+        QProcess generator;
+        generator.start("generatorrunner", args);
+        QVERIFY(generator.waitForFinished());
+        QCOMPARE(generator.exitCode(), 0);
+        QCOMPARE(generator.readAllStandardOutput().contains("Inputs unchanged"), skipped[run]);
+        QVERIFY(QFile::exists(generatedFile));
+    }
+
+    // An edit of a file read by a generator, not by the model, is seen too.
+    QString inputFile = QDir::temp().filePath("dummygentest-input.txt");
+    QFile input(inputFile);
+    QVERIFY(input.open(QIODevice::WriteOnly));
+    input.write("first\n");
+    input.close();
+    args.append("--dummy-input-file=" + inputFile);
+    bool inputSkipped[] = { false, true, false };
+    for (int run = 0; run < 3; ++run) {
+        if (run == 2)
+            QVERIFY(replaceInFile(inputFile, "first", "other"));
+        QProcess generator;
+        generator.start("generatorrunner", args);
+        QVERIFY(generator.waitForFinished());
+        QCOMPARE(generator.exitCode(), 0);
+        QCOMPARE(generator.readAllStandardOutput().contains("Inputs unchanged"), inputSkipped[run]);
+        QFile copy(outputDir + "/dummy_input.txt");
+        QVERIFY(copy.open(QIODevice::ReadOnly));
+        QCOMPARE(copy.readAll(), QByteArray(run == 2 ? "other\n" : "first\n"));
+    }
+
+    QVERIFY(QFile::remove(inputFile));
+    QVERIFY(QFile::remove(headerCopy));
+    removeDirectory(cacheDir);
+    removeDirectory(outputDir);
+}
+
+void DummyGenTest::testShardedGeneration()
+{
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDirPath);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+
+    for (int shard = 1; shard <= 2; ++shard) {
+        int result = QProcess::execute("generatorrunner", QStringList(args) << QString("--shard=%1/2").arg(shard));
+        QCOMPARE(result, 0);
+        QVERIFY(QFile::exists(QString("%1/.DummyGenerator.shard-%2-of-2.data").arg(outputDirPath).arg(shard)));
+    }
+    int result = QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards=2");
+    QCOMPARE(result, 0);
+
+    QFile generatedFile(generatedFilePath);
+    generatedFile.open(QIODevice::ReadOnly);
+    QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    generatedFile.close();
+
+    QVERIFY(generatedFile.remove());
+
+    // Merging fails without the data of every shard.
+    QVERIFY(QFile::remove(outputDirPath + "/.DummyGenerator.shard-2-of-2.data"));
+    result = QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards=2");
+    QVERIFY(result != 0);
+}
+
+void DummyGenTest::testDepfileAndChangedFiles()
+{
+    QString depFilePath = QDir::temp().filePath("dummygentest.d");
+    QString changedFilesPath = QDir::temp().filePath("dummygentest-changed.txt");
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDirPath);
+    args.append("--depfile=" + depFilePath);
+    args.append("--changed-files=" + changedFilesPath);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QFile::remove(generatedFilePath);
+
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+
+    QFile depFile(depFilePath);
+    QVERIFY(depFile.open(QIODevice::ReadOnly));
+    QByteArray depFileContents = depFile.readAll();
+    depFile.close();
+    QVERIFY(depFileContents.startsWith(changedFilesPath.toLocal8Bit() + ':'));
+    QVERIFY(depFileContents.contains(QFileInfo(headerFilePath).absoluteFilePath().toLocal8Bit()));
+    QVERIFY(depFileContents.contains(QFileInfo(typesystemFilePath).absoluteFilePath().toLocal8Bit()));
+
+    QFile changedFiles(changedFilesPath);
+    QVERIFY(changedFiles.open(QIODevice::ReadOnly));
+    QVERIFY(changedFiles.readAll().trimmed().endsWith("dummy_generated.txt"));
+    changedFiles.close();
+
+    // Generating the same contents again changes nothing.
+    result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QVERIFY(changedFiles.open(QIODevice::ReadOnly));
+    QVERIFY(changedFiles.readAll().trimmed().isEmpty());
+    changedFiles.close();
+
+    QVERIFY(QFile::remove(generatedFilePath));
+    QVERIFY(depFile.remove());
+    QVERIFY(changedFiles.remove());
+
+    // The depfile needs the changed files list as its target.
+    args.removeAll("--changed-files=" + changedFilesPath);
+    result = QProcess::execute("generatorrunner", args);
+    QVERIFY(result != 0);
+    QVERIFY(!depFile.exists());
+}
+
+void DummyGenTest::testOutputCache()
+{
+    QString cacheDir = QDir::temp().filePath("dummygentest-cache");
+    QString headerCopy = QDir::temp().filePath("dummygentest-cache.h");
+    removeDirectory(cacheDir);
+    QFile::remove(headerCopy);
+    QVERIFY(QFile::copy(headerFilePath, headerCopy));
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDirPath);
+    args.append("--output-cache=" + cacheDir);
+    args.append(headerCopy);
+    args.append(typesystemFilePath);
+
+    // The first run fills the cache and the second one copies the file from it. The last
+    // one misses it, since any change of the inputs may change the generated code.
+    for (int run = 0; run < 3; ++run) {
+        if (run == 2)
+            QVERIFY(replaceInFile(headerCopy, "struct Dummy {};", "struct Dummy {};\n// changed"));
+        QFile::remove(generatedFilePath);
+        int result = QProcess::execute("generatorrunner", args);
+        QCOMPARE(result, 0);
+
+        QFile generatedFile(generatedFilePath);
+        QVERIFY(generatedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    }
+
+    QProcess stats;
+    stats.start("generatorrunner", QStringList() << "--output-cache=" + cacheDir << "--output-cache-stats");
+    QVERIFY(stats.waitForFinished());
+    QByteArray output = stats.readAllStandardOutput();
+    QVERIFY(output.contains("hits: 1\n"));
+    QVERIFY(output.contains("misses: 2\n"));
+
+    QVERIFY(QFile::remove(generatedFilePath));
+    QVERIFY(QFile::remove(headerCopy));
+    removeDirectory(cacheDir);
+}
+
+void DummyGenTest::testOutputCacheAcrossTrees()
+{
+    // Two build trees of the same sources share the cached files.
+    QString cacheDir = QDir::temp().filePath("dummygentest-cache");
+    removeDirectory(cacheDir);
+    QStringList trees;
+    trees << QDir::temp().filePath("dummygentest-tree1") << QDir::temp().filePath("dummygentest-tree2");
+    foreach (const QString& tree, trees) {
+        removeDirectory(tree);
+        QVERIFY(QDir().mkpath(tree));
+        QVERIFY(QFile::copy(headerFilePath, tree + "/test_global.h"));
+        QVERIFY(QFile::copy(typesystemFilePath, tree + "/test_typesystem.xml"));
+
+        QStringList args;
+        args.append("--generator-set=dummy");
+        args.append("--output-directory=" + tree + "/out");
+        args.append("--output-cache=" + cacheDir);
+        args.append(tree + "/test_global.h");
+        args.append(tree + "/test_typesystem.xml");
+        int result = QProcess::execute("generatorrunner", args);
+        QCOMPARE(result, 0);
+
+        QFile generatedFile(tree + "/out/dummy/dummy_generated.txt");
+        QVERIFY(generatedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    }
+
+    QProcess stats;
+    stats.start("generatorrunner", QStringList() << "--output-cache=" + cacheDir << "--output-cache-stats");
+    QVERIFY(stats.waitForFinished());
+    QByteArray output = stats.readAllStandardOutput();
+    QVERIFY(output.contains("hits: 1\n"));
+    QVERIFY(output.contains("misses: 1\n"));
+
+    foreach (const QString& tree, trees)
+        removeDirectory(tree);
+    removeDirectory(cacheDir);
+}
+
+void DummyGenTest::testOutputArchive()
+{
+    QString archiveFilePath = QDir::temp().filePath("dummygentest.archive");
+    QFile::remove(generatedFilePath);
+    QStringList args;
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDirPath);
+    args.append("--output-archive=" + archiveFilePath);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    int result = QProcess::execute("generatorrunner", args);
+    QCOMPARE(result, 0);
+    QVERIFY(!QFile::exists(generatedFilePath));
+
+    // The second extraction finds the file already there.
+    QStringList extractArgs;
+    extractArgs.append("--extract-archive=" + archiveFilePath);
+    extractArgs.append("--output-directory=" + outputDirPath);
+    for (int run = 0; run < 2; ++run) {
+        QProcess extract;
+        extract.start("generatorrunner", extractArgs);
+        QVERIFY(extract.waitForFinished());
+        QCOMPARE(extract.exitCode(), 0);
+        QByteArray output = extract.readAllStandardOutput();
+        QVERIFY(output.contains(run ? "Done, 0 of 1 files written" : "Done, 1 of 1 files written"));
+
+        QFile generatedFile(generatedFilePath);
+        QVERIFY(generatedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(generatedFile.readAll().trimmed(), QByteArray(GENERATED_CONTENTS).trimmed());
+    }
+
+    // The files removed from the archive are removed by the next extraction.
+    QString typesystemCopy = QDir::temp().filePath("dummygentest-archive.xml");
+    QFile::remove(typesystemCopy);
+    QVERIFY(QFile::copy(typesystemFilePath, typesystemCopy));
+    QVERIFY(replaceInFile(typesystemCopy, "<value-type name='Dummy'/>", ""));
+    QStringList emptyArgs(args);
+    emptyArgs.replace(emptyArgs.indexOf(typesystemFilePath), typesystemCopy);
+    result = QProcess::execute("generatorrunner", emptyArgs);
+    QCOMPARE(result, 0);
+    result = QProcess::execute("generatorrunner", extractArgs);
+    QCOMPARE(result, 0);
+    QVERIFY(!QFile::exists(generatedFilePath));
+    QVERIFY(QFile::remove(typesystemCopy));
+
+    // A file written by the generator itself misses the archive.
+    QString finishFilePath = outputDirPath + "/dummy_finish.txt";
+    QFile::remove(finishFilePath);
+    QProcess finish;
+    finish.setProcessChannelMode(QProcess::MergedChannels);
+    finish.start("generatorrunner", QStringList(args) << "--dummy-finish-file");
+    QVERIFY(finish.waitForFinished());
+    QCOMPARE(finish.exitCode(), 0);
+    QVERIFY(finish.readAll().contains("dummy_finish.txt' was written to disk instead of the output archive"));
+    QVERIFY(QFile::remove(finishFilePath));
+
+    QVERIFY(QFile::remove(archiveFilePath));
+
+    // The shards would overwrite each other's archive.
+    result = QProcess::execute("generatorrunner", QStringList(args) << "--shard=1/2");
+    QVERIFY(result != 0);
+    result = QProcess::execute("generatorrunner", QStringList(args) << "--merge-shards=2");
+    QVERIFY(result != 0);
+    QVERIFY(!QFile::exists(archiveFilePath));
+}
+
+void DummyGenTest::testGeneratorServer()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The generator server needs Unix domain sockets", SkipAll);
+#endif
+    // The server can't find the dummy generator by itself, the job needs the
+    // QT_PLUGIN_PATH of the client.
+    QString socketName = QDir::temp().filePath("dummygentest.socket");
+    QString outputDir = QDir::temp().filePath("dummygentest-server");
+    removeDirectory(outputDir);
+    QStringList serverEnvironment = QProcess::systemEnvironment().filter(QRegExp("^(?!QT_PLUGIN_PATH=)"));
+    QProcess server;
+    server.setEnvironment(serverEnvironment);
+    server.start("generatorrunner", QStringList() << "--server=" + socketName);
+    QVERIFY(server.waitForReadyRead());
+    QVERIFY(server.readAllStandardOutput().contains("Listening on"));
+
+    QStringList args;
+    args.append("--server-socket=" + socketName);
+    args.append("--generator-set=dummy");
+    args.append("--output-directory=" + outputDir);
+    args.append(headerFilePath);
+    args.append(typesystemFilePath);
+    QProcess client;
+    client.start("generatorrunner", args);
+    QVERIFY(client.waitForFinished());
+    QCOMPARE(client.exitCode(), 0);
+    QVERIFY(QFile::exists(outputDir + "/dummy/dummy_generated.txt"));
+
+    // The exit code of a failed job is passed back too.
+    args.replace(1, "--generator-set=nonexistent");
+    client.start("generatorrunner", args);
+    QVERIFY(client.waitForFinished());
+    QVERIFY(client.exitCode() != 0);
+
+    server.kill();
+    server.waitForFinished();
+    QFile::remove(socketName);
+    removeDirectory(outputDir);
+}
+
 void DummyGenTest::testProjectFileArgumentsReading()
 {
     QStringList args(QString("--project-file=%1/dummygentest-project.txt").arg(workDir));
@@ -34,16 +34,36 @@ class DummyGenTest : public QObject
 
 private:
     QString workDir;
+    QString outputDirPath;
     QString headerFilePath;
     QString typesystemFilePath;
     QString generatedFilePath;
     QString projectFilePath;
+    QString shapesHeaderFilePath;
+    QString shapesTypesystemFilePath;
 
 private slots:
     void initTestCase();
+    void init();
+    void cleanup();
     void testCallGenRunnerWithFullPathToDummyGenModule();
     void testCallGenRunnerWithNameOfDummyGenModule();
     void testCallDummyGeneratorExecutable();
+    void testCallGenRunnerWithMultipleJobs();
+    void testMultipleJobsWithSharedTypes();
+    void testMultipleJobsWithUnsafeGenerator();
+    void testMultipleJobsWithoutClasses();
+    void testIncrementalGeneration();
+    void testIncrementalGenerationFollowsDependencies();
+    void testUnityFiles();
+    void testOutputManifest();
+    void testModelCache();
+    void testShardedGeneration();
+    void testDepfileAndChangedFiles();
+    void testOutputCache();
+    void testOutputCacheAcrossTrees();
+    void testOutputArchive();
+    void testGeneratorServer();
     void testProjectFileArgumentsReading();
 };
 
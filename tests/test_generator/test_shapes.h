@@ -0,0 +1,150 @@
+struct Point
+{
+    Point(int x, int y);
+    int x() const;
+    int y() const;
+};
+
+class Shape0
+{
+public:
+    Shape0(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape1
+{
+public:
+    Shape1(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape2
+{
+public:
+    Shape2(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape3
+{
+public:
+    Shape3(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape4
+{
+public:
+    Shape4(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape5
+{
+public:
+    Shape5(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape6
+{
+public:
+    Shape6(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape7
+{
+public:
+    Shape7(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape8
+{
+public:
+    Shape8(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape9
+{
+public:
+    Shape9(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape10
+{
+public:
+    Shape10(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape11
+{
+public:
+    Shape11(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape12
+{
+public:
+    Shape12(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape13
+{
+public:
+    Shape13(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape14
+{
+public:
+    Shape14(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};
+
+class Shape15
+{
+public:
+    Shape15(const Point& origin);
+    Point center() const;
+    void move(const Point& delta, Point* result);
+    int area() const;
+};